@@ -0,0 +1,119 @@
+#include "bspcmd.h"
+#include "g_levellocals.h"
+#include "d_event.h"
+#include <random>
+
+void G_SetMap(const char* mapname, int mode);
+void D_SingleTick();
+
+BSPCmdletGroup::BSPCmdletGroup()
+{
+	SetLongFormName("bsp");
+	SetShortDescription("BSP tree commands");
+
+	AddCommand<BSPVerifyGridCmdlet>();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+BSPVerifyGridCmdlet::BSPVerifyGridCmdlet()
+{
+	SetLongFormName("verifygrid");
+	SetShortDescription("Compare subsector grid lookups against the BSP tree");
+}
+
+// Random points in and around the grid, and points right next to the vertices
+// and partition line origins where rounding is most likely to go wrong.
+static int VerifyGrid(const FSubsectorGrid &grid, node_t *head, int numpoints, const char *name)
+{
+	if (head == nullptr)
+	{
+		Printf("%s nodes: none\n", name);
+		return 0;
+	}
+	if (grid.Width == 0)
+	{
+		Printf("%s nodes: no grid\n", name);
+		return 0;
+	}
+
+	std::mt19937 rng(1234);
+	const int64_t margin = int64_t(256) << FRACBITS;
+	std::uniform_int_distribution<int64_t> randx(grid.MinX - margin, grid.MinX + (int64_t(grid.Width) << grid.CellShift) + margin);
+	std::uniform_int_distribution<int64_t> randy(grid.MinY - margin, grid.MinY + (int64_t(grid.Height) << grid.CellShift) + margin);
+	std::uniform_int_distribution<int> randoffset(-2, 2);
+
+	int errors = 0;
+	auto check = [&](int64_t x, int64_t y)
+	{
+		fixed_t fx = fixed_t(clamp<int64_t>(x, INT32_MIN, INT32_MAX));
+		fixed_t fy = fixed_t(clamp<int64_t>(y, INT32_MIN, INT32_MAX));
+		subsector_t *expected = FSubsectorGrid::WalkBSP(head, fx, fy);
+		subsector_t *found = grid.FindSubsector(head, fx, fy);
+		if (found != expected && ++errors <= 10)
+		{
+			Printf("%s nodes: mismatch at (%.5f, %.5f)\n", name, FIXED2DBL(fx), FIXED2DBL(fy));
+		}
+	};
+
+	for (int i = 0; i < numpoints; i++)
+	{
+		check(randx(rng), randy(rng));
+	}
+	for (auto &v : level.vertexes)
+	{
+		check(FloatToFixed(v.fX()) + randoffset(rng), FloatToFixed(v.fY()) + randoffset(rng));
+	}
+	auto nodes = head == level.HeadNode() ? &level.nodes : &level.gamenodes;
+	for (auto &node : *nodes)
+	{
+		check(int64_t(node.x) + randoffset(rng), int64_t(node.y) + randoffset(rng));
+	}
+
+	unsigned direct = 0;
+	for (auto cell : grid.Cells)
+	{
+		if ((size_t)cell & 1) direct++;
+	}
+	Printf("%s nodes: %ux%u cells of %g units, %.1f%% resolved directly, %d mismatches\n", name, grid.Width, grid.Height,
+		double(int64_t(1) << grid.CellShift) / FRACUNIT, grid.Cells.Size() ? direct * 100. / grid.Cells.Size() : 0., errors);
+	return errors;
+}
+
+void BSPVerifyGridCmdlet::OnCommand(FArgs args)
+{
+	RunInGame([&]() {
+
+		FString mapname;
+		if (args.NumArgs() > 0 && args.GetArg(0)[0] != '-')
+			mapname = args.GetArg(0);
+		else
+			mapname = "map01";
+
+		int numpoints = 1000000;
+		if (args.NumArgs() > 1 && args.GetArg(1)[0] != '-')
+			numpoints = max(atoi(args.GetArg(1)), 0);
+
+		G_SetMap(mapname.GetChars(), 0);
+		for (int i = 0; i < 100; i++)
+		{
+			D_SingleTick();
+			if (gameaction == ga_nothing)
+				break;
+		}
+
+		int errors = VerifyGrid(level.RenderSubsectorGrid, level.HeadNode(), numpoints, "Render");
+		if (level.gamenodes.Size() > 0)
+			errors += VerifyGrid(level.GameSubsectorGrid, level.HeadGamenode(), numpoints, "Game");
+
+		if (errors == 0)
+			Printf("Subsector grid verified.\n");
+		else
+			Printf("Subsector grid verification failed.\n");
+	});
+}
+
+void BSPVerifyGridCmdlet::OnPrintHelp()
+{
+	Printf(TEXTCOLOR_ORANGE "bsp verifygrid " TEXTCOLOR_CYAN "[map name] [number of points]" TEXTCOLOR_NORMAL " - Checks that lookups through the subsector grid find the same subsectors as a walk down the BSP tree\n");
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "commandlet.h"
+
+class BSPCmdletGroup : public CommandletGroup
+{
+public:
+	BSPCmdletGroup();
+};
+
+class BSPVerifyGridCmdlet : public Commandlet
+{
+public:
+	BSPVerifyGridCmdlet();
+	void OnCommand(FArgs args) override;
+	void OnPrintHelp() override;
+};
@@ -42,6 +42,7 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/document.h"
+#include "rapidjson/memorystream.h"
 #include "serializer.h"
 #include "dobject.h"
 #include "filesystem.h"
@@ -120,16 +121,435 @@ const char *UnicodeToString(const char *cc)
 
 //==========================================================================
 //
+// Binary format reader. Sends the same events to the document as the JSON
+// parser would for the equivalent text.
 //
+//==========================================================================
+
+struct FBinarySerializerGenerator
+{
+	const uint8_t *mPos;
+	const uint8_t *mEnd;
+	TArray<FBinaryKey> mKeys;
+	const TArray<FBinaryKey> *mKnownKeys = nullptr;	// for reading a part of the data with the keys of all of it
+	bool mFinished = false;		// set once the root value is complete and all data was used
+
+	struct FContainer
+	{
+		unsigned Count;		// number of values in it
+		bool IsObject;
+		bool HasKey;		// an object's key is waiting for its value
+	};
+	TArray<FContainer> mOpen;
+
+	// The document builds its values on a stack without checking anything,
+	// so the structure must be valid before it gets any event.
+	bool AddValue()
+	{
+		if (mOpen.Size() == 0) return true;
+		auto &open = mOpen.Last();
+		if (open.IsObject)
+		{
+			if (!open.HasKey) return false;
+			open.HasKey = false;
+		}
+		open.Count++;
+		return true;
+	}
+
+	bool AddKey()
+	{
+		if (mOpen.Size() == 0 || !mOpen.Last().IsObject || mOpen.Last().HasKey) return false;
+		mOpen.Last().HasKey = true;
+		return true;
+	}
+
+	bool Close(bool isobject, unsigned &count)
+	{
+		if (mOpen.Size() == 0 || mOpen.Last().IsObject != isobject || mOpen.Last().HasKey) return false;
+		count = mOpen.Last().Count;
+		mOpen.Pop();
+		return true;
+	}
+
+	// The root value must end exactly where the data does.
+	bool Finish()
+	{
+		mFinished = mPos == mEnd;
+		return mFinished;
+	}
+
+	bool GetVarint(uint64_t &v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64 && mPos < mEnd; shift += 7)
+		{
+			uint8_t b = *mPos++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool GetBytes(const char *&p, unsigned &len)
+	{
+		uint64_t l;
+		if (!GetVarint(l) || l > uint64_t(mEnd - mPos)) return false;
+		p = (const char *)mPos;
+		len = (unsigned)l;
+		mPos += l;
+		return true;
+	}
+
+	template<class Handler>
+	bool operator()(Handler &handler)
+	{
+		while (mPos < mEnd)
+		{
+			uint8_t token = *mPos++;
+			bool isvalue = token != BINSER_EndObject && token != BINSER_EndArray && token != BINSER_Key && token != BINSER_NewKey;
+			if (isvalue && !AddValue()) return false;
+			if (!isvalue && token != BINSER_EndObject && token != BINSER_EndArray && !AddKey()) return false;
+
+			uint64_t v;
+			const char *str;
+			unsigned len;
+			bool ok;
+			switch (token)
+			{
+			case BINSER_Null:
+				ok = handler.Null();
+				break;
+
+			case BINSER_False:
+			case BINSER_True:
+				ok = handler.Bool(token == BINSER_True);
+				break;
+
+			case BINSER_Int:
+			{
+				if (!GetVarint(v)) return false;
+				int64_t i = int64_t(v >> 1) ^ -int64_t(v & 1);
+				if (i >= 0) ok = i <= UINT32_MAX ? handler.Uint(uint32_t(i)) : handler.Uint64(uint64_t(i));
+				else ok = i >= INT32_MIN ? handler.Int(int32_t(i)) : handler.Int64(i);
+				break;
+			}
+
+			case BINSER_Uint:
+				if (!GetVarint(v)) return false;
+				ok = v <= UINT32_MAX ? handler.Uint(uint32_t(v)) : handler.Uint64(v);
+				break;
+
+			case BINSER_Double:
+			{
+				if (mEnd - mPos < 8) return false;
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; i++) bits |= uint64_t(mPos[i]) << (i * 8);
+				mPos += 8;
+				double d;
+				memcpy(&d, &bits, 8);
+				ok = handler.Double(d);
+				break;
+			}
+
+			case BINSER_String:
+				if (!GetBytes(str, len)) return false;
+				ok = handler.String(str, len, true);
+				break;
+
+			case BINSER_StartObject:
+				mOpen.Push({ 0, true, false });
+				ok = handler.StartObject();
+				break;
+
+			case BINSER_StartArray:
+				mOpen.Push({ 0, false, false });
+				ok = handler.StartArray();
+				break;
+
+			case BINSER_EndObject:
+			case BINSER_EndArray:
+			{
+				unsigned count;
+				if (!Close(token == BINSER_EndObject, count)) return false;
+				ok = token == BINSER_EndObject ? handler.EndObject(count) : handler.EndArray(count);
+				if (ok && mOpen.Size() == 0) return Finish();	// the root is complete.
+				break;
+			}
+
+			case BINSER_NewKey:
+				if (!GetBytes(str, len)) return false;
+				if (mKnownKeys == nullptr) mKeys.Push({ str, len });
+				ok = handler.Key(str, len, true);
+				break;
+
+			case BINSER_Key:
+			{
+				auto &keys = mKnownKeys != nullptr ? *mKnownKeys : mKeys;
+				if (!GetVarint(v) || v >= keys.Size()) return false;
+				ok = handler.Key(keys[(unsigned)v].str, keys[(unsigned)v].len, true);
+				break;
+			}
+
+			default:
+				return false;
+			}
+			if (!ok) return false;
+			if (isvalue && mOpen.Size() == 0) return Finish();	// the root is a single value.
+		}
+		return false;
+	}
+};
+
+bool IsBinarySerializerData(const char *buffer, size_t length)
+{
+	return length >= sizeof(BinarySerializerMagic) && !memcmp(buffer, BinarySerializerMagic, sizeof(BinarySerializerMagic));
+}
+
+bool ReadBinarySerializerData(rapidjson::Document &doc, const char *buffer, size_t length)
+{
+	FBinarySerializerGenerator gen;
+	gen.mPos = (const uint8_t *)buffer + sizeof(BinarySerializerMagic);
+	gen.mEnd = (const uint8_t *)buffer + length;
+	doc.Populate(gen);
+	return gen.mFinished && doc.IsObject();
+}
+
+//==========================================================================
+//
+// Finds the location of every member of the root object, without
+// building any DOM for them.
 //
 //==========================================================================
 
-bool FSerializer::OpenWriter(bool pretty)
+struct FJSONPosition
+{
+	rapidjson::MemoryStream &stream;
+	const char *buffer;
+	size_t length;
+
+	size_t Tell() const { return stream.Tell(); }
+	size_t ValueStart() const
+	{
+		size_t pos = stream.Tell();
+		while (pos < length && (buffer[pos] == ':' || buffer[pos] == ' ' || buffer[pos] == '\t' || buffer[pos] == '\n' || buffer[pos] == '\r')) pos++;
+		return pos;
+	}
+};
+
+struct FBinaryPosition
+{
+	const uint8_t *&pos;
+	const uint8_t *buffer;
+
+	size_t Tell() const { return pos - buffer; }
+	size_t ValueStart() const { return Tell(); }
+};
+
+template<class Position>
+struct FRootMemberLocator : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, FRootMemberLocator<Position>>
+{
+	TArray<FReader::FRootMember> &mMembers;
+	Position mPosition;
+	int mDepth = 0;
+
+	FRootMemberLocator(TArray<FReader::FRootMember> &members, const Position &pos) : mMembers(members), mPosition(pos) {}
+
+	void Element()
+	{
+		if (mDepth == 2 && mMembers.Last().Type == rapidjson::kArrayType) mMembers.Last().Count++;
+	}
+
+	bool Default()
+	{
+		if (mDepth == 0) return false;	// the root must be an object.
+		Element();
+		if (mDepth == 1) mMembers.Last().End = mPosition.Tell();
+		return true;
+	}
+
+	bool Null()
+	{
+		if (mDepth == 1) mMembers.Last().Type = rapidjson::kNullType;
+		return Default();
+	}
+
+	bool StartObject()
+	{
+		Element();
+		if (mDepth == 1) mMembers.Last().Type = rapidjson::kObjectType;
+		mDepth++;
+		return true;
+	}
+
+	bool StartArray()
+	{
+		if (mDepth == 0) return false;
+		Element();
+		if (mDepth == 1) mMembers.Last().Type = rapidjson::kArrayType;
+		mDepth++;
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType)
+	{
+		if (--mDepth == 1) mMembers.Last().End = mPosition.Tell();
+		return true;
+	}
+
+	bool EndArray(rapidjson::SizeType count)
+	{
+		return EndObject(count);
+	}
+
+	bool Key(const char *str, rapidjson::SizeType len, bool)
+	{
+		if (mDepth == 1)
+		{
+			size_t start = mPosition.ValueStart();
+			mMembers.Push({ FString(str, len), start, start, rapidjson::kNumberType, 0, nullptr });
+		}
+		return true;
+	}
+};
+
+bool FReader::LocateRootMembers()
+{
+	const char *buffer = mBuffer.Data();
+	size_t length = mBuffer.Size();
+	bool ok;
+
+	if (IsBinarySerializerData(buffer, length))
+	{
+		FBinarySerializerGenerator gen;
+		gen.mPos = (const uint8_t *)buffer + sizeof(BinarySerializerMagic);
+		gen.mEnd = (const uint8_t *)buffer + length;
+		FRootMemberLocator<FBinaryPosition> locator(mRootMembers, { gen.mPos, (const uint8_t *)buffer });
+		ok = gen(locator);
+		mBinaryKeys = std::move(gen.mKeys);
+	}
+	else
+	{
+		rapidjson::MemoryStream stream(buffer, length);
+		rapidjson::Reader reader;
+		FRootMemberLocator<FJSONPosition> locator(mRootMembers, { stream, buffer, length });
+		ok = !reader.Parse<rapidjson::kParseNumbersAsStringsFlag | rapidjson::kParseStopWhenDoneFlag>(stream, locator).IsError();
+	}
+	return ok && mRootMembers.Size() > 0;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FReader::FReader(TArray<char> &&buffer) : mBuffer(std::move(buffer))
+{
+	if (LocateRootMembers())
+	{
+		mDoc.SetObject();
+	}
+	else
+	{
+		// Either empty or broken. Let the parser deal with it as a whole.
+		mRootMembers.Clear();
+		mBinaryKeys.Clear();
+		if (IsBinarySerializerData(mBuffer.Data(), mBuffer.Size()))
+		{
+			if (!ReadBinarySerializerData(mDoc, mBuffer.Data(), mBuffer.Size()))
+			{
+				mDoc.SetObject();
+				mBadData++;
+			}
+		}
+		else
+		{
+			mDoc.Parse(mBuffer.Data(), mBuffer.Size());
+		}
+		mBuffer.Reset();
+	}
+	mObjects.Push(FJSONObject(&mDoc));
+}
+
+FReader::~FReader()
+{
+	for (auto &member : mRootMembers)
+	{
+		delete member.Doc;
+	}
+}
+
+int FReader::FindRootIndex(const char *key)
+{
+	unsigned index = mRootNext;
+	if (index >= mRootMembers.Size() || mRootMembers[index].Key.Compare(key))
+	{
+		for (index = 0; index < mRootMembers.Size(); index++)
+		{
+			if (!mRootMembers[index].Key.Compare(key)) break;
+		}
+		if (index == mRootMembers.Size()) return -1;
+	}
+	mRootNext = index + 1;
+	return index;
+}
+
+rapidjson::Value *FReader::GetRootMember(unsigned index)
+{
+	auto &member = mRootMembers[index];
+	if (member.Doc == nullptr)
+	{
+		// A lookup at the root level means that nothing is looking into the other members anymore.
+		for (auto &other : mRootMembers)
+		{
+			delete other.Doc;
+			other.Doc = nullptr;
+		}
+
+		member.Doc = new rapidjson::Document;
+		const char *buffer = mBuffer.Data();
+		if (IsBinarySerializerData(buffer, mBuffer.Size()))
+		{
+			FBinarySerializerGenerator gen;
+			gen.mPos = (const uint8_t *)buffer + member.Start;
+			gen.mEnd = (const uint8_t *)buffer + member.End;
+			gen.mKnownKeys = &mBinaryKeys;
+			member.Doc->Populate(gen);
+			if (!gen.mFinished)
+			{
+				Printf(TEXTCOLOR_RED "Invalid binary data for '%s'\n", member.Key.GetChars());
+				member.Doc->SetNull();
+				mBadData++;
+			}
+		}
+		else
+		{
+			member.Doc->Parse(buffer + member.Start, member.End - member.Start);
+		}
+	}
+	return member.Doc;
+}
+
+const char *FReader::NextRootKey()
+{
+	if (mRootIterator >= mRootMembers.Size()) return nullptr;
+	mKeyValue = GetRootMember(mRootIterator);
+	return mRootMembers[mRootIterator++].Key.GetChars();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FSerializer::OpenWriter(bool pretty, bool binary)
 {
 	if (w != nullptr || r != nullptr) return false;
 
 	mErrors = 0;
-	w = new FWriter(pretty);
+	w = new FWriter(pretty, binary);
 	BeginObject(nullptr);
 	return true;
 }
@@ -145,8 +565,10 @@ bool FSerializer::OpenReader(const char *buffer, size_t length)
 	if (w != nullptr || r != nullptr) return false;
 
 	mErrors = 0;
-	r = new FReader(buffer, length);
-	return true;
+	TArray<char> copy(length, true);
+	memcpy(copy.Data(), buffer, length);
+	r = new FReader(std::move(copy));
+	return CheckReader();
 }
 
 //==========================================================================
@@ -161,17 +583,49 @@ bool FSerializer::OpenReader(FCompressedBuffer *input)
 	if (w != nullptr || r != nullptr) return false;
 
 	mErrors = 0;
+	TArray<char> unpacked(input->mSize, true);
 	if (input->mMethod == METHOD_STORED)
 	{
-		r = new FReader((char*)input->mBuffer, input->mSize);
+		memcpy(unpacked.Data(), input->mBuffer, input->mSize);
 	}
 	else
 	{
-		TArray<char> unpacked(input->mSize);
 		input->Decompress(unpacked.Data());
-		r = new FReader(unpacked.Data(), input->mSize);
 	}
-	return true;
+	r = new FReader(std::move(unpacked));
+	return CheckReader();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FSerializer::OpenReader(TArray<char> &&buffer)
+{
+	if (buffer.Size() == 0) return false;
+	if (w != nullptr || r != nullptr) return false;
+
+	mErrors = 0;
+	r = new FReader(std::move(buffer));
+	return CheckReader();
+}
+
+//==========================================================================
+//
+// Truncated or otherwise broken binary data cannot be read at all.
+//
+//==========================================================================
+
+bool FSerializer::CheckReader()
+{
+	if (r->mBadData == 0) return true;
+
+	Printf(TEXTCOLOR_RED "Invalid or truncated binary data\n");
+	delete r;
+	r = nullptr;
+	return false;
 }
 
 //==========================================================================
@@ -192,6 +646,7 @@ void FSerializer::Close()
 	if (r != nullptr)
 	{
 		CloseReaderCustom();
+		mErrors += r->mBadData;	// members that could not be decoded when they were looked up
 		delete r;
 		r = nullptr;
 	}
@@ -301,6 +756,7 @@ bool FSerializer::HasKey(const char* name)
 {
 	if (isReading())
 	{
+		if (r->IsRootLookup(name)) return r->FindRootIndex(name) >= 0;
 		return r->FindKey(name) != nullptr;
 	}
 	return false;
@@ -316,6 +772,11 @@ bool FSerializer::HasObject(const char* name)
 {
 	if (isReading())
 	{
+		if (r->IsRootLookup(name))
+		{
+			int index = r->FindRootIndex(name);
+			return index >= 0 && r->mRootMembers[index].Type == rapidjson::kObjectType;
+		}
 		auto val = r->FindKey(name);
 		if (val != nullptr)
 		{
@@ -338,6 +799,11 @@ bool FSerializer::IsKeyNull(const char* name)
 {
 	if (isReading())
 	{
+		if (r->IsRootLookup(name))
+		{
+			int index = r->FindRootIndex(name);
+			return index >= 0 && r->mRootMembers[index].Type == rapidjson::kNullType;
+		}
 		auto val = r->FindKey(name);
 		if (val != nullptr)
 		{
@@ -606,6 +1072,15 @@ unsigned FSerializer::GetSize(const char *group)
 {
 	if (isWriting()) return -1;	// we do not know this when writing.
 
+	if (r->IsRootLookup(group))
+	{
+		// don't parse a whole member just for its size.
+		int index = r->FindRootIndex(group);
+		if (index < 0) return 0;
+		auto &member = r->mRootMembers[index];
+		return member.Type == rapidjson::kArrayType ? member.Count : -1;
+	}
+
 	const rapidjson::Value *val = r->FindKey(group);
 	if (!val) return 0;
 	if (!val->IsArray()) return -1;
@@ -622,6 +1097,7 @@ unsigned FSerializer::GetSize(const char *group)
 const char *FSerializer::GetKey()
 {
 	if (isWriting()) return nullptr;	// we do not know this when writing.
+	if (r->mObjects.Size() == 1 && r->mRootMembers.Size() > 0) return r->NextRootKey();
 	if (!r->mObjects.Last().mObject->IsObject()) return nullptr;	// non-objects do not have keys.
 	auto &it = r->mObjects.Last().mIterator;
 	if (it == r->mObjects.Last().mObject->MemberEnd()) return nullptr;
@@ -786,21 +1262,50 @@ const char *FSerializer::GetOutput(unsigned *len)
 //==========================================================================
 
 FCompressedBuffer FSerializer::GetCompressedOutput()
+{
+	auto buff = GetStoredOutput();
+	CompressBuffer(buff);
+	return buff;
+}
+
+//==========================================================================
+//
+// Returns the output as an uncompressed buffer that can be compressed
+// with CompressBuffer later, even on another thread.
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::GetStoredOutput()
 {
 	if (isReading()) return{ 0,0,0,0,0,nullptr };
 	FCompressedBuffer buff;
 	WriteObjects();
 	EndObject();
 	buff.filename = nullptr;
-	buff.mSize = (unsigned)w->mOutString.GetSize();
+	buff.mSize = buff.mCompressedSize = (unsigned)w->mOutString.GetSize();
 	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
+	buff.mMethod = METHOD_STORED;
+	buff.mBuffer = new char[buff.mSize + 1];
+	memcpy(buff.mBuffer, w->mOutString.GetString(), buff.mSize + 1);
+	return buff;
+}
+
+//==========================================================================
+//
+// Deflates a stored buffer. If that fails it is left as it is.
+//
+//==========================================================================
+
+void FSerializer::CompressBuffer(FCompressedBuffer &buff)
+{
+	if (buff.mMethod != METHOD_STORED || buff.mBuffer == nullptr) return;
 
 	uint8_t *compressbuf = new uint8_t[buff.mSize+1];
 
 	z_stream stream;
 	int err;
 
-	stream.next_in = (Bytef *)w->mOutString.GetString();
+	stream.next_in = (Bytef *)buff.mBuffer;
 	stream.avail_in = (unsigned)buff.mSize;
 	stream.next_out = (Bytef*)compressbuf;
 	stream.avail_out = (unsigned)buff.mSize;
@@ -812,32 +1317,28 @@ FCompressedBuffer FSerializer::GetCompressedOutput()
 	err = deflateInit2(&stream, 8, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
 	if (err != Z_OK)
 	{
-		goto error;
+		delete[] compressbuf;
+		return;
 	}
 
 	err = deflate(&stream, Z_FINISH);
 	if (err != Z_STREAM_END) 
 	{
 		deflateEnd(&stream);
-		goto error;
+		delete[] compressbuf;
+		return;
 	}
-	buff.mCompressedSize = stream.total_out;
 
 	err = deflateEnd(&stream);
 	if (err == Z_OK)
 	{
+		delete[] buff.mBuffer;
+		buff.mCompressedSize = stream.total_out;
 		buff.mBuffer = new char[buff.mCompressedSize];
 		buff.mMethod = METHOD_DEFLATE;
 		memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
-		delete[] compressbuf;
-		return buff;
 	}
-
-error:
-	memcpy(compressbuf, w->mOutString.GetString(), buff.mSize + 1);
-	buff.mCompressedSize = buff.mSize;
-	buff.mMethod = METHOD_STORED;
-	return buff;
+	delete[] compressbuf;
 }
 
 //==========================================================================
@@ -78,6 +78,7 @@ public:
 
 private:
 	virtual void CloseReaderCustom() {}
+	bool CheckReader();
 public:
 
 	~FSerializer()
@@ -86,9 +87,10 @@ public:
 		Close();
 	}
 	void SetUniqueSoundNames() { soundNamesAreUnique = true; }
-	bool OpenWriter(bool pretty = true);
+	bool OpenWriter(bool pretty = true, bool binary = false);	// binary output can be read back like JSON but is not human-readable
 	bool OpenReader(const char *buffer, size_t length);
 	bool OpenReader(FileSys::FCompressedBuffer *input);
+	bool OpenReader(TArray<char> &&buffer);
 	void Close();
 	void ReadObjects(bool hubtravel);
 	bool BeginObject(const char *name);
@@ -102,6 +104,8 @@ public:
 	const char *GetKey();
 	const char *GetOutput(unsigned *len = nullptr);
 	FileSys::FCompressedBuffer GetCompressedOutput();
+	FileSys::FCompressedBuffer GetStoredOutput();
+	static void CompressBuffer(FileSys::FCompressedBuffer &buff);
 	// The sprite serializer is a special case because it is needed by the VM to handle its 'spriteid' type.
 	virtual FSerializer &Sprite(const char *key, int32_t &spritenum, int32_t *def);
 	// This is only needed by the type system.
@@ -12,12 +12,13 @@ struct FJSONObject
 {
 	rapidjson::Value* mObject;
 	rapidjson::Value::MemberIterator mIterator;
+	rapidjson::Value::MemberIterator mNext;	// where the next key lookup starts looking
 	int mIndex;
 
 	FJSONObject(rapidjson::Value* v)
 	{
 		mObject = v;
-		if (v->IsObject()) mIterator = v->MemberBegin();
+		if (v->IsObject()) mIterator = mNext = v->MemberBegin();
 		else if (v->IsArray())
 		{
 			mIndex = 0;
@@ -25,6 +26,46 @@ struct FJSONObject
 	}
 };
 
+//==========================================================================
+//
+// Binary encoding
+//
+// The same structure as the JSON output, only with cheaper tokens: keys are
+// written once and referenced by index afterward, integers are varints and
+// doubles are stored as their raw 8 bytes. The reader turns this into the
+// same document the JSON parser would have produced, so nothing else needs
+// to care about which of the two formats it gets.
+//
+//==========================================================================
+
+enum
+{
+	BINSER_Null,
+	BINSER_False,
+	BINSER_True,
+	BINSER_Int,			// zigzag varint
+	BINSER_Uint,		// varint
+	BINSER_Double,		// 8 bytes, little endian
+	BINSER_String,		// varint length, bytes
+	BINSER_StartObject,
+	BINSER_EndObject,
+	BINSER_StartArray,
+	BINSER_EndArray,
+	BINSER_Key,			// varint index of a key that was written before
+	BINSER_NewKey,		// varint length, bytes. Gets the next key index.
+};
+
+static const char BinarySerializerMagic[4] = { 'G', 'Z', 'B', 'S' };
+
+struct FBinaryKey
+{
+	const char *str;
+	unsigned len;
+};
+
+bool IsBinarySerializerData(const char *buffer, size_t length);
+bool ReadBinarySerializerData(rapidjson::Document &doc, const char *buffer, size_t length);
+
 //==========================================================================
 //
 // some wrapper stuff to keep the RapidJSON dependencies out of the global headers.
@@ -39,21 +80,32 @@ struct FWriter
 
 	Writer *mWriter1;
 	PrettyWriter *mWriter2;
+	bool mBinary;
 	TArray<bool> mInObject;
 	rapidjson::StringBuffer mOutString;
 	TArray<DObject *> mDObjects;
 	TMap<DObject *, int> mObjectMap;
 
-	FWriter(bool pretty)
+	// interned keys for the binary format
+	TArray<FString> mKeys;
+	TMap<FString, unsigned> mKeyIndex;
+	TMap<const char *, unsigned> mKeyAddress;	// shortcut for string literals, verified before use
+
+	FWriter(bool pretty, bool binary = false)
 	{
-		if (!pretty)
+		mBinary = binary;
+		mWriter1 = nullptr;
+		mWriter2 = nullptr;
+		if (binary)
+		{
+			memcpy(mOutString.Push(sizeof(BinarySerializerMagic)), BinarySerializerMagic, sizeof(BinarySerializerMagic));
+		}
+		else if (!pretty)
 		{
 			mWriter1 = new Writer(mOutString);
-			mWriter2 = nullptr;
 		}
 		else
 		{
-			mWriter1 = nullptr;
 			mWriter2 = new PrettyWriter(mOutString);
 		}
 	}
@@ -70,40 +122,107 @@ struct FWriter
 		return mInObject.Size() > 0 && mInObject.Last();
 	}
 
+	void PutToken(uint8_t token)
+	{
+		mOutString.Put((char)token);
+	}
+
+	void PutVarint(uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			mOutString.Put((char)(v | 0x80));
+			v >>= 7;
+		}
+		mOutString.Put((char)v);
+	}
+
+	void PutBytes(const char *p, size_t len)
+	{
+		PutVarint(len);
+		if (len > 0) memcpy(mOutString.Push(len), p, len);
+	}
+
+	void PutKey(const char *k)
+	{
+		unsigned *pindex = mKeyAddress.CheckKey(k);
+		if (pindex == nullptr || mKeys[*pindex].Compare(k) != 0)
+		{
+			FString key = k;
+			pindex = mKeyIndex.CheckKey(key);
+			if (pindex == nullptr)
+			{
+				unsigned index = mKeys.Push(key);
+				mKeyIndex[key] = index;
+				mKeyAddress[k] = index;
+				PutToken(BINSER_NewKey);
+				PutBytes(key.GetChars(), key.Len());
+				return;
+			}
+			mKeyAddress[k] = *pindex;
+		}
+		PutToken(BINSER_Key);
+		PutVarint(*pindex);
+	}
+
+	void PutString(const char *k)
+	{
+		PutToken(BINSER_String);
+		PutBytes(k, strlen(k));
+	}
+
+	void PutInt(int64_t k)
+	{
+		PutToken(BINSER_Int);
+		PutVarint((uint64_t(k) << 1) ^ uint64_t(k >> 63));
+	}
+
+	void PutUint(uint64_t k)
+	{
+		PutToken(BINSER_Uint);
+		PutVarint(k);
+	}
+
 	void StartObject()
 	{
 		if (mWriter1) mWriter1->StartObject();
 		else if (mWriter2) mWriter2->StartObject();
+		else PutToken(BINSER_StartObject);
 	}
 
 	void EndObject()
 	{
 		if (mWriter1) mWriter1->EndObject();
 		else if (mWriter2) mWriter2->EndObject();
+		else PutToken(BINSER_EndObject);
 	}
 
 	void StartArray()
 	{
 		if (mWriter1) mWriter1->StartArray();
 		else if (mWriter2) mWriter2->StartArray();
+		else PutToken(BINSER_StartArray);
 	}
 
 	void EndArray()
 	{
 		if (mWriter1) mWriter1->EndArray();
 		else if (mWriter2) mWriter2->EndArray();
+		else PutToken(BINSER_EndArray);
 	}
 
 	void Key(const char *k)
 	{
 		if (mWriter1) mWriter1->Key(k);
 		else if (mWriter2) mWriter2->Key(k);
+		else PutKey(k);
 	}
 
 	void Null()
 	{
 		if (mWriter1) mWriter1->Null();
 		else if (mWriter2) mWriter2->Null();
+		else PutToken(BINSER_Null);
 	}
 
 	void StringU(const char *k, bool encode)
@@ -111,6 +230,7 @@ struct FWriter
 		if (encode) k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else PutString(k);
 	}
 
 	void String(const char *k)
@@ -118,6 +238,7 @@ struct FWriter
 		k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else PutString(k);
 	}
 
 	void String(const char *k, int size)
@@ -125,36 +246,42 @@ struct FWriter
 		k = StringToUnicode(k, size);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else PutString(k);
 	}
 
 	void Bool(bool k)
 	{
 		if (mWriter1) mWriter1->Bool(k);
 		else if (mWriter2) mWriter2->Bool(k);
+		else PutToken(k ? BINSER_True : BINSER_False);
 	}
 
 	void Int(int32_t k)
 	{
 		if (mWriter1) mWriter1->Int(k);
 		else if (mWriter2) mWriter2->Int(k);
+		else PutInt(k);
 	}
 
 	void Int64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Int64(k);
 		else if (mWriter2) mWriter2->Int64(k);
+		else PutInt(k);
 	}
 
 	void Uint(uint32_t k)
 	{
 		if (mWriter1) mWriter1->Uint(k);
 		else if (mWriter2) mWriter2->Uint(k);
+		else PutUint(k);
 	}
 
 	void Uint64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Uint64(k);
 		else if (mWriter2) mWriter2->Uint64(k);
+		else PutUint((uint64_t)k);
 	}
 
 	void Double(double k)
@@ -167,6 +294,15 @@ struct FWriter
 		{
 			mWriter2->Double(k);
 		}
+		else
+		{
+			uint8_t bytes[8];
+			uint64_t bits;
+			memcpy(&bits, &k, 8);
+			for (int i = 0; i < 8; i++) bytes[i] = uint8_t(bits >> (i * 8));
+			PutToken(BINSER_Double);
+			memcpy(mOutString.Push(8), bytes, 8);
+		}
 	}
 
 };
@@ -179,16 +315,45 @@ struct FWriter
 
 struct FReader
 {
+	// Large documents are not turned into one DOM. Only the members of the
+	// root object get located, and each of them is parsed into a document of
+	// its own once it is looked up. The serializer reads them one after the
+	// other, so the member read before gets thrown away at that point and only
+	// one of them needs to be in memory at a time. A member that is requested
+	// again is parsed again from its location.
+	struct FRootMember
+	{
+		FString Key;
+		size_t Start, End;			// location of the value in mBuffer
+		rapidjson::Type Type;		// only object, array and null are told apart
+		int Count;					// number of elements for arrays
+		rapidjson::Document *Doc;
+	};
+
 	TArray<FJSONObject> mObjects;
 	rapidjson::Document mDoc;
 	TArray<DObject *> mDObjects;
 	rapidjson::Value *mKeyValue = nullptr;
 	bool mObjectsRead = false;
 
-	FReader(const char *buffer, size_t length)
+	TArray<char> mBuffer;
+	TArray<FRootMember> mRootMembers;
+	TArray<FBinaryKey> mBinaryKeys;
+	unsigned mRootNext = 0;
+	unsigned mRootIterator = 0;
+	int mBadData = 0;			// number of places where the binary data could not be decoded
+
+	FReader(TArray<char> &&buffer);
+	~FReader();
+
+	bool LocateRootMembers();
+	int FindRootIndex(const char *key);
+	rapidjson::Value *GetRootMember(unsigned index);
+	const char *NextRootKey();
+
+	bool IsRootLookup(const char *key) const
 	{
-		mDoc.Parse(buffer, length);
-		mObjects.Push(FJSONObject(&mDoc));
+		return key != nullptr && mObjects.Size() == 1 && mRootMembers.Size() > 0;
 	}
 
 	rapidjson::Value *FindKey(const char *key)
@@ -204,11 +369,23 @@ struct FReader
 				mKeyValue = nullptr;
 				return p;
 			}
+			else if (IsRootLookup(key))
+			{
+				int index = FindRootIndex(key);
+				return index < 0 ? nullptr : GetRootMember(index);
+			}
 			else
 			{
+				// Keys are mostly requested in the order they were written, so try the one after the last match first.
+				auto end = obj.mObject->MemberEnd();
+				if (obj.mNext != end && !strcmp(obj.mNext->name.GetString(), key))
+				{
+					return &(obj.mNext++)->value;
+				}
 				// Find the given key by name;
 				auto it = obj.mObject->FindMember(key);
-				if (it == obj.mObject->MemberEnd()) return nullptr;
+				if (it == end) return nullptr;
+				obj.mNext = it + 1;
 				return &it->value;
 			}
 		}
@@ -247,6 +247,7 @@ public:
 	}
 
 	bool OpenFile(const char *filename, Size start = 0, Size length = -1, bool buffered = false);
+	bool OpenFileMapped(const char *filename);	// maps the whole file into memory, falls back to OpenFile if that fails
 	bool OpenFilePart(FileReader &parent, Size start, Size length);
 	bool OpenMemory(const void *mem, Size length);	// read directly from the buffer
 	bool OpenMemoryArray(FileData& data);	// take the given array
@@ -320,6 +320,15 @@ bool FZipFile::Open(LumpFilterInfo* filter, FileSystemMessageFunc Printf)
 
 	GenerateHash();
 	PostProcessArchive(filter);
+
+	// Data in a mapped archive can be read from any thread, so nothing may be changed later.
+	if (Reader.GetBuffer() != nullptr)
+	{
+		for (uint32_t i = 0; i < NumLumps; i++)
+		{
+			if (Entries[i].Flags & RESFF_NEEDFILESTART) SetEntryAddress(i);
+		}
+	}
 	return true;
 }
 
@@ -363,8 +372,18 @@ void FZipFile::SetEntryAddress(uint32_t entry)
 	FZipLocalFileHeader localHeader;
 	int skiplen;
 
-	Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
-	Reader.Read(&localHeader, sizeof(localHeader));
+	memset(&localHeader, 0, sizeof(localHeader));
+	auto buf = Reader.GetBuffer();
+	if (buf != nullptr && Entries[entry].Position + sizeof(localHeader) <= (size_t)Reader.GetLength())
+	{
+		// a mapped archive does not need the shared reader's file position for this.
+		memcpy(&localHeader, buf + Entries[entry].Position, sizeof(localHeader));
+	}
+	else
+	{
+		Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
+		Reader.Read(&localHeader, sizeof(localHeader));
+	}
 	skiplen = LittleShort(localHeader.NameLength) + LittleShort(localHeader.ExtraLength);
 	Entries[entry].Position += sizeof(localHeader) + skiplen;
 	Entries[entry].Flags &= ~RESFF_NEEDFILESTART;
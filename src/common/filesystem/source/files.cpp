@@ -40,6 +40,18 @@
 #include <string.h>
 #include "files_internal.h"
 
+#ifdef _WIN32
+#ifndef _WINNT_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace FileSys {
 	
 #ifdef _WIN32
@@ -171,6 +183,76 @@ private:
 	}
 };
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// maps the entire file into memory. Since it is a MemoryReader, GetBuffer
+// exposes the mapping, so the resource file can hand out its lumps as
+// views into it without copying them and without needing a file handle,
+// which also makes it safe to read them from any thread.
+//
+//==========================================================================
+
+class MappedFileReader : public MemoryReader
+{
+#ifdef _WIN32
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	HANDLE hMapping = nullptr;
+#endif
+
+public:
+	~MappedFileReader()
+	{
+#ifdef _WIN32
+		if (bufptr != nullptr) UnmapViewOfFile(bufptr);
+		if (hMapping != nullptr) CloseHandle(hMapping);
+		if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+#else
+		if (bufptr != nullptr) munmap((void*)bufptr, Length);
+#endif
+		bufptr = nullptr;
+	}
+
+	bool Open(const char *filename)
+	{
+#ifdef _WIN32
+		auto widename = toWide(filename);
+		hFile = CreateFileW(widename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hFile, &size) || !CanMap(size.QuadPart)) return false;
+		hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (hMapping == nullptr) return false;
+		auto mem = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mem == nullptr) return false;
+		Length = (ptrdiff_t)size.QuadPart;
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		void *mem = MAP_FAILED;
+		if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && CanMap(info.st_size))
+		{
+			mem = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		close(fd);	// the mapping stays valid without the descriptor.
+		if (mem == MAP_FAILED) return false;
+		Length = (ptrdiff_t)info.st_size;
+#endif
+		bufptr = (const char*)mem;
+		FilePos = 0;
+		return true;
+	}
+
+private:
+	static bool CanMap(int64_t size)
+	{
+		// Empty files cannot be mapped, and on 32 bit systems large archives would take too much of the address space.
+		return size > 0 && (sizeof(void*) >= 8 || size < 0x10000000);
+	}
+};
+
 //==========================================================================
 //
 // FileReaderRedirect
@@ -380,6 +462,20 @@ bool FileReader::OpenFile(const char *filename, FileReader::Size start, FileRead
 	return true;
 }
 
+bool FileReader::OpenFileMapped(const char *filename)
+{
+	auto reader = new MappedFileReader;
+	if (!reader->Open(filename))
+	{
+		// if the file cannot be mapped, read it the regular way.
+		delete reader;
+		return OpenFile(filename);
+	}
+	Close();
+	mReader = reader;
+	return true;
+}
+
 bool FileReader::OpenFilePart(FileReader &parent, FileReader::Size start, FileReader::Size length)
 {
 	auto reader = new FileReaderRedirect(parent, start, length);
@@ -354,7 +354,7 @@ void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInf
 
 		if (!isdir)
 		{
-			if (!filereader.OpenFile(filename))
+			if (!filereader.OpenFileMapped(filename))
 			{ // Didn't find file
 				if (Printf)
 				{
@@ -702,6 +702,16 @@ int FResourceFile::FindEntry(const char *name)
 //
 //==========================================================================
 
+// The directory of a broken archive may point past its end. Memory backed
+// archives must not be read past the buffer, so only the part inside of it
+// is used, like a short read from a file.
+static size_t BufferedSize(FileReader &reader, size_t position, size_t length)
+{
+	size_t size = (size_t)reader.GetLength();
+	if (position >= size) return 0;
+	return std::min(length, size - position);
+}
+
 FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int readerflags)
 {
 	FileReader fr;
@@ -717,7 +727,7 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 			// if this is backed by a memory buffer, create a new reader directly referencing it.
 			if (buf != nullptr)
 			{
-				fr.OpenMemory(buf + Entries[entry].Position, Entries[entry].Length);
+				fr.OpenMemory(buf + Entries[entry].Position, BufferedSize(Reader, Entries[entry].Position, Entries[entry].Length));
 			}
 			else
 			{
@@ -742,7 +752,9 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 		else
 		{
 			FileReader fri;
-			if (readertype == READER_NEW || !mainThread) fri.OpenFile(FileName, Entries[entry].Position, Entries[entry].CompressedSize);
+			auto buf = Reader.GetBuffer();
+			if (buf != nullptr) fri.OpenMemory(buf + Entries[entry].Position, BufferedSize(Reader, Entries[entry].Position, Entries[entry].CompressedSize));
+			else if (readertype == READER_NEW || !mainThread) fri.OpenFile(FileName, Entries[entry].Position, Entries[entry].CompressedSize);
 			else fri.OpenFilePart(Reader, Entries[entry].Position, Entries[entry].CompressedSize);
 			int flags = DCF_TRANSFEROWNER | DCF_EXCEPTIONS;
 			if (readertype == READER_CACHED) flags |= DCF_CACHED;
@@ -755,11 +767,15 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 
 FileData FResourceFile::Read(uint32_t entry)
 {
-	if (!(Entries[entry].Flags & RESFF_COMPRESSED) && Reader.isOpen())
+	if (entry < NumLumps && !(Entries[entry].Flags & RESFF_COMPRESSED) && Reader.isOpen())
 	{
+		if (Entries[entry].Flags & RESFF_NEEDFILESTART)
+		{
+			SetEntryAddress(entry);
+		}
 		auto buf = Reader.GetBuffer();
 		// if this is backed by a memory buffer, we can just return a reference to the backing store.
-		if (buf != nullptr)
+		if (buf != nullptr && BufferedSize(Reader, Entries[entry].Position, Entries[entry].Length) == Entries[entry].Length)
 		{
 			return FileData(buf + Entries[entry].Position, Entries[entry].Length, false);
 		}
@@ -0,0 +1,303 @@
+/*
+** dobjalloc.cpp
+** Size-class allocator for object memory
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** All DObjects get their memory from here. Sizes are rounded up to a size
+** class and every size class carves its objects out of large chunks, so
+** objects of similar size end up next to each other and memory freed by the
+** collector's sweep is handed out again without going through the C heap.
+**
+** Chunks are aligned to CHUNK_PAGE bytes. Every page of a chunk is entered
+** in a hash map, so freeing only needs the address to find its chunk.
+** Objects too large for any size class are allocated with M_Malloc.
+**
+*/
+
+#include <stdlib.h>
+#include "dobject.h"
+#include "m_alloc.h"
+#include "printf.h"
+
+enum
+{
+	CHUNK_PAGE_SHIFT = 16,
+	CHUNK_PAGE = 1 << CHUNK_PAGE_SHIFT,
+	MIN_CHUNK_SLOTS = 16,
+	MAX_SLOT_SIZE = 16384,
+};
+
+struct FObjectSizeClass;
+
+struct FObjectChunk
+{
+	FObjectSizeClass *SizeClass;
+	void *RawMemory;
+	uint8_t *Slots;
+	size_t Bytes;
+	void *FreeList;			// slots that were freed, most recent first
+	unsigned NumSlots;
+	unsigned NumUsed;
+	unsigned NumCarved;		// slots above this were never handed out
+	FObjectChunk *PrevPartial, *NextPartial;
+	bool InPartialList;
+};
+
+struct FObjectSizeClass
+{
+	size_t SlotSize = 0;
+	unsigned NumChunks = 0;
+	size_t NumUsed = 0;
+	FObjectChunk *PartialHead = nullptr;	// chunks with free slots. Allocations come from the head.
+	FObjectChunk *PartialTail = nullptr;
+};
+
+// Size classes are 16 bytes apart up to 512, 64 bytes up to 4096 and 256 bytes above.
+static const int NUM_SIZE_CLASSES = 512 / 16 + (4096 - 512) / 64 + (MAX_SLOT_SIZE - 4096) / 256;
+
+static FObjectSizeClass SizeClasses[NUM_SIZE_CLASSES];
+static TMap<size_t, FObjectChunk *> ChunkPages;
+static size_t ChunkBytes;
+
+static int GetSizeClass(size_t size)
+{
+	if (size <= 512)
+		return (int)((size + 15) / 16) - 1;
+	if (size <= 4096)
+		return 512 / 16 + (int)((size - 512 + 63) / 64) - 1;
+	return 512 / 16 + (4096 - 512) / 64 + (int)((size - 4096 + 255) / 256) - 1;
+}
+
+static size_t GetSlotSize(int sizeclass)
+{
+	if (sizeclass < 512 / 16)
+		return (sizeclass + 1) * 16;
+	sizeclass -= 512 / 16;
+	if (sizeclass < (4096 - 512) / 64)
+		return 512 + (sizeclass + 1) * 64;
+	sizeclass -= (4096 - 512) / 64;
+	return 4096 + (sizeclass + 1) * 256;
+}
+
+static void LinkPartial(FObjectSizeClass *sc, FObjectChunk *chunk)
+{
+	// Appended at the tail so that the chunk at the head gets filled up first.
+	chunk->PrevPartial = sc->PartialTail;
+	chunk->NextPartial = nullptr;
+	if (sc->PartialTail) sc->PartialTail->NextPartial = chunk;
+	else sc->PartialHead = chunk;
+	sc->PartialTail = chunk;
+	chunk->InPartialList = true;
+}
+
+static void UnlinkPartial(FObjectSizeClass *sc, FObjectChunk *chunk)
+{
+	if (chunk->PrevPartial) chunk->PrevPartial->NextPartial = chunk->NextPartial;
+	else sc->PartialHead = chunk->NextPartial;
+	if (chunk->NextPartial) chunk->NextPartial->PrevPartial = chunk->PrevPartial;
+	else sc->PartialTail = chunk->PrevPartial;
+	chunk->PrevPartial = chunk->NextPartial = nullptr;
+	chunk->InPartialList = false;
+}
+
+static FObjectChunk *NewChunk(FObjectSizeClass *sc)
+{
+	size_t bytes = (sc->SlotSize * MIN_CHUNK_SLOTS + CHUNK_PAGE - 1) & ~(size_t)(CHUNK_PAGE - 1);
+
+	// Not M_Malloc: the collector is told about every object, not about the chunks.
+	void *raw = malloc(bytes + CHUNK_PAGE);
+	if (raw == nullptr)
+	{
+		I_FatalError("Could not allocate %zu bytes for objects", bytes);
+	}
+
+	auto chunk = new FObjectChunk;
+	chunk->SizeClass = sc;
+	chunk->RawMemory = raw;
+	chunk->Slots = (uint8_t *)(((uintptr_t)raw + CHUNK_PAGE - 1) & ~(uintptr_t)(CHUNK_PAGE - 1));
+	chunk->Bytes = bytes;
+	chunk->FreeList = nullptr;
+	chunk->NumSlots = (unsigned)(bytes / sc->SlotSize);
+	chunk->NumUsed = 0;
+	chunk->NumCarved = 0;
+	chunk->PrevPartial = chunk->NextPartial = nullptr;
+	chunk->InPartialList = false;
+
+	for (size_t page = 0; page < bytes; page += CHUNK_PAGE)
+	{
+		ChunkPages.Insert(((uintptr_t)chunk->Slots + page) >> CHUNK_PAGE_SHIFT, chunk);
+	}
+	sc->NumChunks++;
+	ChunkBytes += bytes;
+	LinkPartial(sc, chunk);
+	return chunk;
+}
+
+static void DeleteChunk(FObjectChunk *chunk)
+{
+	FObjectSizeClass *sc = chunk->SizeClass;
+	if (chunk->InPartialList)
+		UnlinkPartial(sc, chunk);
+	for (size_t page = 0; page < chunk->Bytes; page += CHUNK_PAGE)
+	{
+		ChunkPages.Remove(((uintptr_t)chunk->Slots + page) >> CHUNK_PAGE_SHIFT);
+	}
+	sc->NumChunks--;
+	ChunkBytes -= chunk->Bytes;
+	free(chunk->RawMemory);
+	delete chunk;
+}
+
+namespace GC
+{
+
+//==========================================================================
+//
+// AllocObject
+//
+// Returns uninitialized memory for an object of the given size.
+//
+//==========================================================================
+
+void *AllocObject(size_t size)
+{
+	if (size > MAX_SLOT_SIZE)
+	{
+		return M_Malloc(size);
+	}
+
+	FObjectSizeClass *sc = &SizeClasses[GetSizeClass(size)];
+	if (sc->SlotSize == 0)
+	{
+		sc->SlotSize = GetSlotSize(GetSizeClass(size));
+	}
+
+	FObjectChunk *chunk = sc->PartialHead;
+	if (chunk == nullptr)
+	{
+		chunk = NewChunk(sc);
+	}
+
+	void *mem;
+	if (chunk->FreeList != nullptr)
+	{
+		mem = chunk->FreeList;
+		chunk->FreeList = *(void **)mem;
+	}
+	else
+	{
+		mem = chunk->Slots + chunk->NumCarved * sc->SlotSize;
+		chunk->NumCarved++;
+	}
+
+	chunk->NumUsed++;
+	sc->NumUsed++;
+	if (chunk->NumUsed == chunk->NumSlots)
+	{
+		UnlinkPartial(sc, chunk);
+	}
+	ReportAlloc(sc->SlotSize);
+	return mem;
+}
+
+//==========================================================================
+//
+// FreeObject
+//
+//==========================================================================
+
+void FreeObject(void *mem)
+{
+	if (mem == nullptr)
+		return;
+
+	auto pchunk = ChunkPages.CheckKey((uintptr_t)mem >> CHUNK_PAGE_SHIFT);
+	if (pchunk == nullptr)
+	{
+		M_Free(mem);
+		return;
+	}
+
+	FObjectChunk *chunk = *pchunk;
+	FObjectSizeClass *sc = chunk->SizeClass;
+	assert(((uint8_t *)mem - chunk->Slots) % sc->SlotSize == 0);
+
+	*(void **)mem = chunk->FreeList;
+	chunk->FreeList = mem;
+	chunk->NumUsed--;
+	sc->NumUsed--;
+	ReportDealloc(sc->SlotSize);
+
+	if (!chunk->InPartialList)
+	{
+		LinkPartial(sc, chunk);
+	}
+	else if (chunk->NumUsed == 0 && sc->PartialHead != sc->PartialTail)
+	{
+		// Keep one empty chunk around per size class, give the rest back.
+		DeleteChunk(chunk);
+	}
+}
+
+//==========================================================================
+//
+// ObjectAllocSize
+//
+// Returns how much memory an object of the given size really takes.
+//
+//==========================================================================
+
+size_t ObjectAllocSize(size_t size)
+{
+	return size > MAX_SLOT_SIZE ? size : GetSlotSize(GetSizeClass(size));
+}
+
+//==========================================================================
+//
+// GetObjectAllocStats
+//
+//==========================================================================
+
+void GetObjectAllocStats(size_t &chunkbytes, size_t &usedbytes, int &numchunks, int &numclasses)
+{
+	chunkbytes = ChunkBytes;
+	usedbytes = 0;
+	numchunks = 0;
+	numclasses = 0;
+	for (auto &sc : SizeClasses)
+	{
+		if (sc.NumChunks > 0)
+		{
+			usedbytes += sc.NumUsed * sc.SlotSize;
+			numchunks += sc.NumChunks;
+			numclasses++;
+		}
+	}
+}
+
+}
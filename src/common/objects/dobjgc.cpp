@@ -56,6 +56,7 @@
 
 // HEADER FILES ------------------------------------------------------------
 
+#include <algorithm>
 #include "dobject.h"
 
 #include "c_dispatch.h"
@@ -756,6 +757,44 @@ size_t FAveragizer::GetAverage()
 	return TotalCount != 0 ? TotalAmount / TotalCount : 0;
 }
 
+//==========================================================================
+//
+// GetClassMemory
+//
+// Collects the memory used by the live objects of every class, largest first.
+//
+//==========================================================================
+
+struct FClassMemory
+{
+	PClass *Class;
+	int Count;
+	size_t Bytes;
+};
+
+static void GetClassMemory(TArray<FClassMemory> &classes)
+{
+	TMap<PClass *, unsigned> index;
+	classes.Clear();
+	for (DObject *obj = GC::Root; obj != nullptr; obj = obj->ObjNext)
+	{
+		PClass *cls = obj->GetClass();
+		if (cls == nullptr)
+			continue;
+
+		auto pindex = index.CheckKey(cls);
+		if (pindex == nullptr)
+		{
+			index.Insert(cls, classes.Size());
+			classes.Push({ cls, 0, 0 });
+			pindex = index.CheckKey(cls);
+		}
+		classes[*pindex].Count++;
+		classes[*pindex].Bytes += GC::ObjectAllocSize(cls->Size);
+	}
+	std::sort(classes.begin(), classes.end(), [](const FClassMemory &a, const FClassMemory &b) { return a.Bytes > b.Bytes; });
+}
+
 //==========================================================================
 //
 // STAT gc
@@ -787,6 +826,19 @@ ADD_STAT(gc)
 		(GC::AllocBytes + 1023) >> 10,
 		(GC::Estimate + 1023) >> 10,
 		(GC::Threshold + 1023) >> 10);
+
+	size_t chunkbytes, usedbytes;
+	int numchunks, numclasses;
+	GC::GetObjectAllocStats(chunkbytes, usedbytes, numchunks, numclasses);
+	out.AppendFormat("\nSlabs: %d chunks in %d size classes  Used:%6zuK of %6zuK",
+		numchunks, numclasses, (usedbytes + 1023) >> 10, (chunkbytes + 1023) >> 10);
+
+	TArray<FClassMemory> classes;
+	GetClassMemory(classes);
+	for (unsigned i = 0; i < classes.Size() && i < 5; i++)
+	{
+		out.AppendFormat("\n  %-24s %6d objects %6zuK", classes[i].Class->TypeName.GetChars(), classes[i].Count, (classes[i].Bytes + 1023) >> 10);
+	}
 	return out;
 }
 
@@ -842,7 +894,7 @@ CCMD(gc)
 {
 	if (argv.argc() == 1)
 	{
-		Printf ("Usage: gc stop|now|full|count|pause [size]|stepmul [size]\n");
+		Printf ("Usage: gc stop|now|full|count|classes|pause [size]|stepmul [size]\n");
 		return;
 	}
 	if (stricmp(argv[1], "stop") == 0)
@@ -863,6 +915,16 @@ CCMD(gc)
 		for (DObject *obj = GC::Root; obj; obj = obj->ObjNext, cnt++);
 		Printf("%d active objects counted\n", cnt);
 	}
+	else if (stricmp(argv[1], "classes") == 0)
+	{
+		TArray<FClassMemory> classes;
+		GetClassMemory(classes);
+		for (auto &cls : classes)
+		{
+			Printf("%-32s %6d objects %8zuK\n", cls.Class->TypeName.GetChars(), cls.Count, (cls.Bytes + 1023) >> 10);
+		}
+		Printf("%d classes with live objects\n", classes.Size());
+	}
 	else if (stricmp(argv[1], "pause") == 0)
 	{
 		if (argv.argc() == 2)
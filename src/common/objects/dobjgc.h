@@ -175,6 +175,12 @@ namespace GC
 	using GCMarkerFunc = void(*)();
 	void AddMarkerFunc(GCMarkerFunc func);
 
+	// Object memory. Objects are grouped by size class in dobjalloc.cpp.
+	void *AllocObject(size_t size);
+	void FreeObject(void *mem);
+	size_t ObjectAllocSize(size_t size);
+	void GetObjectAllocStats(size_t &chunkbytes, size_t &usedbytes, int &numchunks, int &numclasses);
+
 	// Report an allocation to the GC
 	static inline void ReportAlloc(size_t alloc)
 	{
@@ -44,6 +44,7 @@ CVAR(Bool, warningstoerrors, false, CVAR_GLOBALCONFIG | CVAR_ARCHIVE)
 
 EXTERN_CVAR(Bool, vm_jit)
 EXTERN_CVAR(Bool, vm_jit_aot)
+EXTERN_CVAR(Bool, vm_jit_tiered)
 
 struct VMRemap
 {
@@ -121,6 +122,7 @@ void VMFunctionBuilder::MakeFunction(VMScriptFunction *func)
 	// Copy code block.
 	memcpy(func->Code, &Code[0], Code.Size() * sizeof(VMOP));
 	memcpy(func->LineInfo, &LineNumbers[0], LineNumbers.Size() * sizeof(LineNumbers[0]));
+	func->VirtualCalls = VirtualCalls;
 
 	// Create constant tables.
 	if (IntConstantList.Size() > 0)
@@ -383,6 +385,20 @@ void VMFunctionBuilder::ParamChange(int delta)
 	}
 }
 
+//==========================================================================
+//
+// VMFunctionBuilder :: AddVirtualCall
+//
+// The VM only needs the virtual index, but the JIT can call the declared
+// function directly if the object's class does not override it.
+//
+//==========================================================================
+
+void VMFunctionBuilder::AddVirtualCall(VMFunction *declared)
+{
+	VirtualCalls.Push({ Code.Size(), declared });
+}
+
 //==========================================================================
 //
 // VMFunctionBuilder :: RegAvailability - Constructor
@@ -839,6 +855,7 @@ VMFunction *FFunctionBuildList::AddFunction(PNamespace *gnspc, const VersionInfo
 void FFunctionBuildList::Build()
 {
 	VMDisassemblyDumper disasmdump(VMDisassemblyDumper::Overwrite);
+	TArray<VMScriptFunction *> aotFunctions;
 
 	for (auto &item : mItems)
 	{
@@ -942,9 +959,10 @@ void FFunctionBuildList::Build()
 				sfunc->Unsafe = ctx.Unsafe;
 
 				#if HAVE_VM_JIT
-					if(vm_jit && vm_jit_aot)
+					if(vm_jit && vm_jit_aot && !vm_jit_tiered)
 					{
-						sfunc->JitCompile();
+						// compiled all at once after codegen is done, see below.
+						aotFunctions.Push(sfunc);
 					}
 				#endif
 			}
@@ -957,6 +975,8 @@ void FFunctionBuildList::Build()
 		delete item.Code;
 		disasmdump.Flush();
 	}
+	// Every function is independent once its bytecode exists, so they can be compiled in parallel.
+	VMScriptFunction::JitCompileAll(aotFunctions);
 	VMFunction::CreateRegUseInfo();
 	FScriptPosition::StrictErrors = strictdecorate;
 
@@ -1156,6 +1176,7 @@ ExpEmit FunctionCallEmitter::EmitCall(VMFunctionBuilder *build, TArray<ExpEmit>
 	{
 		ExpEmit funcreg(build, REGT_POINTER);
 
+		build->AddVirtualCall(target);
 		build->Emit(OP_VTBL, funcreg.RegNum, virtualselfreg, target->VirtualIndex);
 		build->Emit(OP_CALL, funcreg.RegNum, paramcount, vm_jit? target->Proto->ReturnTypes.Size() : returns.Size());
 	}
@@ -100,6 +100,9 @@ public:
 	// PARAM increases ActiveParam; CALL decreases it.
 	void ParamChange(int delta);
 
+	// Remembers the declared target of the OP_VTBL that gets emitted next.
+	void AddVirtualCall(VMFunction *declared);
+
 	// Track available registers.
 	RegAvailability Registers[4];
 
@@ -112,6 +115,7 @@ public:
 
 private:
 	TArray<FStatementInfo> LineNumbers;
+	TArray<FVirtualCallInfo> VirtualCalls;
 	TArray<FxExpression *> StatementStack;
 
 	TArray<int> IntConstantList;
@@ -0,0 +1,1241 @@
+/*
+** zcc_cache.cpp
+**
+** Persistent on-disk cache for parsed ZScript syntax trees
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The cache stores the syntax tree of one ZSCRIPT lump and all its includes.
+** It is keyed by the engine version and the MD5 of every lump that went into
+** the parse, so any change to a script file or to the engine invalidates it.
+**
+** Names, strings and source lumps are written as table indices instead of
+** raw values, because FName indices and lump numbers differ between runs.
+**
+*/
+
+#include <memory>
+#include "dobject.h"
+#include "sc_man.h"
+#include "filesystem.h"
+#include "cmdlib.h"
+#include "md5.h"
+#include "version.h"
+#include "i_specialpaths.h"
+#include "engineerrors.h"
+#include "printf.h"
+#include "zcc_parser.h"
+
+// Bump this whenever the layout of the syntax tree nodes changes.
+static const uint32_t ASTCACHE_VERSION = 1;
+
+struct FASTCacheLump
+{
+	FString Name;		// name used to look the lump up
+	FString Path;		// full path including the container file
+	uint8_t Checksum[16];
+	int Lump;
+};
+
+//==========================================================================
+//
+// Cache key
+//
+//==========================================================================
+
+static FString GetCacheFileName(int baselump, bool create)
+{
+	FString path = M_GetCachePath(create);
+	path << "/zscript";
+	if (create) CreatePath(path.GetChars());
+
+	uint8_t digest[16];
+	MD5Context md5;
+	auto fullpath = fileSystem.GetFileFullPath(baselump);
+	md5.Update((const uint8_t *)fullpath.c_str(), (unsigned)fullpath.length());
+	md5.Final(digest);
+
+	path << '/';
+	for (auto b : digest) path.AppendFormat("%02x", b);
+	path << ".zsc";
+	return path;
+}
+
+static FString GetEngineKey()
+{
+	FString key;
+	key.Format("%s-%s-%d.%d.%d", GetVersionString(), GetGitHash(), ZSCRIPT_VER_MAJOR, ZSCRIPT_VER_MINOR, ZSCRIPT_VER_REVISION);
+	return key;
+}
+
+static void GetLumpChecksum(int lump, uint8_t checksum[16])
+{
+	auto data = fileSystem.ReadFile(lump);
+	MD5Context md5;
+	md5.Update(data.bytes(), (unsigned)data.size());
+	md5.Final(checksum);
+}
+
+static bool SetupCacheLump(FASTCacheLump &entry, const FString &name, int lump)
+{
+	if (lump < 0) return false;
+	entry.Name = name;
+	entry.Path = fileSystem.GetFileFullPath(lump).c_str();
+	entry.Lump = lump;
+	GetLumpChecksum(lump, entry.Checksum);
+	return true;
+}
+
+//==========================================================================
+//
+// Node serialization
+//
+// One function walks all fields of a node so that the collector, the
+// writer and the reader can never disagree about the layout.
+//
+//==========================================================================
+
+static size_t GetNodeSize(EZCCTreeNodeType type)
+{
+	switch (type)
+	{
+#define NODESIZE(x) case AST_##x: return sizeof(ZCC_##x);
+	NODESIZE(Identifier)
+	NODESIZE(Class)
+	NODESIZE(Struct)
+	NODESIZE(Enum)
+	NODESIZE(EnumTerminator)
+	NODESIZE(States)
+	NODESIZE(StatePart)
+	NODESIZE(StateLabel)
+	NODESIZE(StateStop)
+	NODESIZE(StateWait)
+	NODESIZE(StateFail)
+	NODESIZE(StateLoop)
+	NODESIZE(StateGoto)
+	NODESIZE(StateLine)
+	NODESIZE(VarName)
+	NODESIZE(VarInit)
+	NODESIZE(Type)
+	NODESIZE(BasicType)
+	NODESIZE(MapType)
+	NODESIZE(MapIteratorType)
+	NODESIZE(DynArrayType)
+	NODESIZE(FuncPtrParamDecl)
+	NODESIZE(FuncPtrType)
+	NODESIZE(ClassType)
+	NODESIZE(Expression)
+	NODESIZE(ExprID)
+	NODESIZE(ExprTypeRef)
+	NODESIZE(ExprConstant)
+	NODESIZE(ExprFuncCall)
+	NODESIZE(ExprMemberAccess)
+	NODESIZE(ExprUnary)
+	NODESIZE(ExprBinary)
+	NODESIZE(ExprTrinary)
+	NODESIZE(FuncParm)
+	NODESIZE(Statement)
+	NODESIZE(CompoundStmt)
+	NODESIZE(ContinueStmt)
+	NODESIZE(BreakStmt)
+	NODESIZE(ReturnStmt)
+	NODESIZE(ExpressionStmt)
+	NODESIZE(IterationStmt)
+	NODESIZE(IfStmt)
+	NODESIZE(SwitchStmt)
+	NODESIZE(CaseStmt)
+	NODESIZE(AssignStmt)
+	NODESIZE(AssignDeclStmt)
+	NODESIZE(LocalVarStmt)
+	NODESIZE(FuncParamDecl)
+	NODESIZE(ConstantDef)
+	NODESIZE(Declarator)
+	NODESIZE(VarDeclarator)
+	NODESIZE(FuncDeclarator)
+	NODESIZE(Default)
+	NODESIZE(FlagStmt)
+	NODESIZE(PropertyStmt)
+	NODESIZE(VectorValue)
+	NODESIZE(DeclFlags)
+	NODESIZE(ClassCast)
+	NODESIZE(FunctionPtrCast)
+	NODESIZE(StaticArrayStatement)
+	NODESIZE(Property)
+	NODESIZE(FlagDef)
+	NODESIZE(MixinDef)
+	NODESIZE(MixinStmt)
+	NODESIZE(ArrayIterationStmt)
+	NODESIZE(TwoArgIterationStmt)
+	NODESIZE(ThreeArgIterationStmt)
+	NODESIZE(TypedIterationStmt)
+#undef NODESIZE
+	default:
+		return 0;
+	}
+}
+
+// Takes the most derived type, because ZCC_ConstantDef has its own Symbol that
+// hides the base class's. The parser never sets the hidden one.
+template<class Arc, class T> static void SerializeNamedNode(Arc &arc, T *node)
+{
+	arc.Name(node->NodeName);
+	arc.Null(node->Symbol);
+}
+
+template<class Arc> static void SerializeExpression(Arc &arc, ZCC_Expression *node)
+{
+	arc.Value(node->Operation);
+	arc.Type(node->Type);
+}
+
+template<class Arc> static void SerializeStruct(Arc &arc, ZCC_Struct *node)
+{
+	SerializeNamedNode(arc, node);
+	arc.Value(node->Flags);
+	arc.Node(node->Body);
+	arc.Null(node->Type);
+	arc.Version(node->Version);
+}
+
+template<class Arc> static void SerializeDeclarator(Arc &arc, ZCC_Declarator *node)
+{
+	arc.Node(node->Type);
+	arc.Value(node->Flags);
+	arc.Version(node->Version);
+}
+
+template<class Arc> static void SerializeNode(Arc &arc, ZCC_TreeNode *orig)
+{
+	arc.Node(orig->SiblingNext);
+	arc.Node(orig->SiblingPrev);
+	arc.String(orig->SourceName);
+	arc.Lump(orig->SourceLump);
+	arc.Value(orig->SourceLoc);
+
+	switch (orig->NodeType)
+	{
+	case AST_Identifier:
+		arc.Name(static_cast<ZCC_Identifier *>(orig)->Id);
+		break;
+
+	case AST_Struct:
+		SerializeStruct(arc, static_cast<ZCC_Struct *>(orig));
+		break;
+
+	case AST_Class:
+	{
+		auto node = static_cast<ZCC_Class *>(orig);
+		SerializeStruct(arc, node);
+		arc.Node(node->ParentName);
+		arc.Node(node->Replaces);
+		arc.Node(node->Sealed);
+		break;
+	}
+
+	case AST_Enum:
+	{
+		auto node = static_cast<ZCC_Enum *>(orig);
+		SerializeNamedNode(arc, node);
+		arc.Value(node->EnumType);
+		arc.Node(node->Elements);
+		break;
+	}
+
+	case AST_States:
+	{
+		auto node = static_cast<ZCC_States *>(orig);
+		arc.Node(node->Body);
+		arc.Node(node->Flags);
+		break;
+	}
+
+	case AST_StateLabel:
+		arc.Name(static_cast<ZCC_StateLabel *>(orig)->Label);
+		break;
+
+	case AST_StateGoto:
+	{
+		auto node = static_cast<ZCC_StateGoto *>(orig);
+		arc.Node(node->Qualifier);
+		arc.Node(node->Label);
+		arc.Node(node->Offset);
+		break;
+	}
+
+	case AST_StateLine:
+	{
+		auto node = static_cast<ZCC_StateLine *>(orig);
+		int flags = node->bBright | (node->bFast << 1) | (node->bSlow << 2) | (node->bNoDelay << 3) | (node->bCanRaise << 4);
+		arc.String(node->Sprite);
+		arc.Value(flags);
+		node->bBright = !!(flags & 1);
+		node->bFast = !!(flags & 2);
+		node->bSlow = !!(flags & 4);
+		node->bNoDelay = !!(flags & 8);
+		node->bCanRaise = !!(flags & 16);
+		arc.String(node->Frames);
+		arc.Node(node->Duration);
+		arc.Node(node->Offset);
+		arc.Node(node->Lights);
+		arc.Node(node->Action);
+		break;
+	}
+
+	case AST_VarName:
+	{
+		auto node = static_cast<ZCC_VarName *>(orig);
+		arc.Name(node->Name);
+		arc.Node(node->ArraySize);
+		break;
+	}
+
+	case AST_VarInit:
+	{
+		auto node = static_cast<ZCC_VarInit *>(orig);
+		arc.Name(node->Name);
+		arc.Node(node->ArraySize);
+		arc.Node(node->Init);
+		arc.Value(node->InitIsArray);
+		break;
+	}
+
+	case AST_Type:
+		arc.Node(static_cast<ZCC_Type *>(orig)->ArraySize);
+		break;
+
+	case AST_BasicType:
+	{
+		auto node = static_cast<ZCC_BasicType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Value(node->Type);
+		arc.Node(node->UserType);
+		arc.Value(node->isconst);
+		break;
+	}
+
+	case AST_MapType:
+	{
+		auto node = static_cast<ZCC_MapType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Node(node->KeyType);
+		arc.Node(node->ValueType);
+		break;
+	}
+
+	case AST_MapIteratorType:
+	{
+		auto node = static_cast<ZCC_MapIteratorType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Node(node->KeyType);
+		arc.Node(node->ValueType);
+		break;
+	}
+
+	case AST_DynArrayType:
+	{
+		auto node = static_cast<ZCC_DynArrayType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Node(node->ElementType);
+		break;
+	}
+
+	case AST_FuncPtrParamDecl:
+	{
+		auto node = static_cast<ZCC_FuncPtrParamDecl *>(orig);
+		arc.Node(node->Type);
+		arc.Value(node->Flags);
+		break;
+	}
+
+	case AST_FuncPtrType:
+	{
+		auto node = static_cast<ZCC_FuncPtrType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Node(node->RetType);
+		arc.Node(node->Params);
+		arc.Value(node->Scope);
+		break;
+	}
+
+	case AST_ClassType:
+	{
+		auto node = static_cast<ZCC_ClassType *>(orig);
+		arc.Node(node->ArraySize);
+		arc.Node(node->Restriction);
+		break;
+	}
+
+	case AST_Expression:
+		SerializeExpression(arc, static_cast<ZCC_Expression *>(orig));
+		break;
+
+	case AST_ExprID:
+	{
+		auto node = static_cast<ZCC_ExprID *>(orig);
+		SerializeExpression(arc, node);
+		arc.Name(node->Identifier);
+		break;
+	}
+
+	case AST_ExprTypeRef:
+	{
+		auto node = static_cast<ZCC_ExprTypeRef *>(orig);
+		SerializeExpression(arc, node);
+		arc.Type(node->RefType);
+		break;
+	}
+
+	case AST_ExprConstant:
+	{
+		auto node = static_cast<ZCC_ExprConstant *>(orig);
+		SerializeExpression(arc, node);
+		if (node->Type == TypeString)
+		{
+			arc.String(node->StringVal);
+		}
+		else if (node->Type == TypeFloat64 || node->Type == TypeFloat32)
+		{
+			arc.Float(node->DoubleVal);
+		}
+		else if (node->Type == TypeName)
+		{
+			arc.Name(node->IntVal);
+		}
+		else if (node->Type != nullptr && node->Type->isIntCompatible())
+		{
+			arc.Value(node->IntVal);
+		}
+		else
+		{
+			node->StringVal = nullptr;
+		}
+		break;
+	}
+
+	case AST_ExprFuncCall:
+	{
+		auto node = static_cast<ZCC_ExprFuncCall *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->Function);
+		arc.Node(node->Parameters);
+		break;
+	}
+
+	case AST_ExprMemberAccess:
+	{
+		auto node = static_cast<ZCC_ExprMemberAccess *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->Left);
+		arc.Name(node->Right);
+		break;
+	}
+
+	case AST_ExprUnary:
+	{
+		auto node = static_cast<ZCC_ExprUnary *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->Operand);
+		break;
+	}
+
+	case AST_ExprBinary:
+	{
+		auto node = static_cast<ZCC_ExprBinary *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->Left);
+		arc.Node(node->Right);
+		break;
+	}
+
+	case AST_ExprTrinary:
+	{
+		auto node = static_cast<ZCC_ExprTrinary *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->Test);
+		arc.Node(node->Left);
+		arc.Node(node->Right);
+		break;
+	}
+
+	case AST_FuncParm:
+	{
+		auto node = static_cast<ZCC_FuncParm *>(orig);
+		arc.Node(node->Value);
+		arc.Name(node->Label);
+		break;
+	}
+
+	case AST_CompoundStmt:
+	case AST_Default:
+		arc.Node(static_cast<ZCC_CompoundStmt *>(orig)->Content);
+		break;
+
+	case AST_ReturnStmt:
+		arc.Node(static_cast<ZCC_ReturnStmt *>(orig)->Values);
+		break;
+
+	case AST_ExpressionStmt:
+		arc.Node(static_cast<ZCC_ExpressionStmt *>(orig)->Expression);
+		break;
+
+	case AST_IterationStmt:
+	{
+		auto node = static_cast<ZCC_IterationStmt *>(orig);
+		arc.Node(node->LoopCondition);
+		arc.Node(node->LoopStatement);
+		arc.Node(node->LoopBumper);
+		arc.Value(node->CheckAt);
+		break;
+	}
+
+	case AST_ArrayIterationStmt:
+	{
+		auto node = static_cast<ZCC_ArrayIterationStmt *>(orig);
+		arc.Node(node->ItName);
+		arc.Node(node->ItArray);
+		arc.Node(node->LoopStatement);
+		break;
+	}
+
+	case AST_TwoArgIterationStmt:
+	{
+		auto node = static_cast<ZCC_TwoArgIterationStmt *>(orig);
+		arc.Node(node->ItKey);
+		arc.Node(node->ItValue);
+		arc.Node(node->ItMap);
+		arc.Node(node->LoopStatement);
+		break;
+	}
+
+	case AST_ThreeArgIterationStmt:
+	{
+		auto node = static_cast<ZCC_ThreeArgIterationStmt *>(orig);
+		arc.Node(node->ItVar);
+		arc.Node(node->ItPos);
+		arc.Node(node->ItFlags);
+		arc.Node(node->ItBlock);
+		arc.Node(node->LoopStatement);
+		break;
+	}
+
+	case AST_TypedIterationStmt:
+	{
+		auto node = static_cast<ZCC_TypedIterationStmt *>(orig);
+		arc.Node(node->ItType);
+		arc.Node(node->ItVar);
+		arc.Node(node->ItExpr);
+		arc.Node(node->LoopStatement);
+		break;
+	}
+
+	case AST_IfStmt:
+	{
+		auto node = static_cast<ZCC_IfStmt *>(orig);
+		arc.Node(node->Condition);
+		arc.Node(node->TruePath);
+		arc.Node(node->FalsePath);
+		break;
+	}
+
+	case AST_SwitchStmt:
+	{
+		auto node = static_cast<ZCC_SwitchStmt *>(orig);
+		arc.Node(node->Condition);
+		arc.Node(node->Content);
+		break;
+	}
+
+	case AST_CaseStmt:
+		arc.Node(static_cast<ZCC_CaseStmt *>(orig)->Condition);
+		break;
+
+	case AST_AssignStmt:
+	{
+		auto node = static_cast<ZCC_AssignStmt *>(orig);
+		arc.Node(node->Dests);
+		arc.Node(node->Sources);
+		arc.Value(node->AssignOp);
+		break;
+	}
+
+	case AST_AssignDeclStmt:
+	{
+		auto node = static_cast<ZCC_AssignDeclStmt *>(orig);
+		arc.Node(node->Dests);
+		arc.Node(node->Sources);
+		arc.Value(node->AssignOp);
+		break;
+	}
+
+	case AST_LocalVarStmt:
+	{
+		auto node = static_cast<ZCC_LocalVarStmt *>(orig);
+		arc.Node(node->Type);
+		arc.Node(node->Vars);
+		break;
+	}
+
+	case AST_FuncParamDecl:
+	{
+		auto node = static_cast<ZCC_FuncParamDecl *>(orig);
+		arc.Node(node->Type);
+		arc.Node(node->Default);
+		arc.Name(node->Name);
+		arc.Value(node->Flags);
+		break;
+	}
+
+	case AST_ConstantDef:
+	{
+		auto node = static_cast<ZCC_ConstantDef *>(orig);
+		SerializeNamedNode(arc, node);
+		arc.Node(node->Value);
+		arc.Node(node->Type);
+		break;
+	}
+
+	case AST_Declarator:
+		SerializeDeclarator(arc, static_cast<ZCC_Declarator *>(orig));
+		break;
+
+	case AST_VarDeclarator:
+	{
+		auto node = static_cast<ZCC_VarDeclarator *>(orig);
+		SerializeDeclarator(arc, node);
+		arc.Node(node->Names);
+		arc.String(node->DeprecationMessage);
+		break;
+	}
+
+	case AST_FuncDeclarator:
+	{
+		auto node = static_cast<ZCC_FuncDeclarator *>(orig);
+		SerializeDeclarator(arc, node);
+		arc.Node(node->Params);
+		arc.Name(node->Name);
+		arc.Node(node->Body);
+		arc.Node(node->UseFlags);
+		arc.String(node->DeprecationMessage);
+		break;
+	}
+
+	case AST_FlagStmt:
+	{
+		auto node = static_cast<ZCC_FlagStmt *>(orig);
+		arc.Node(node->name);
+		arc.Value(node->set);
+		break;
+	}
+
+	case AST_PropertyStmt:
+	{
+		auto node = static_cast<ZCC_PropertyStmt *>(orig);
+		arc.Node(node->Prop);
+		arc.Node(node->Values);
+		break;
+	}
+
+	case AST_VectorValue:
+	{
+		auto node = static_cast<ZCC_VectorValue *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->X);
+		arc.Node(node->Y);
+		arc.Node(node->Z);
+		arc.Node(node->W);
+		break;
+	}
+
+	case AST_DeclFlags:
+	{
+		auto node = static_cast<ZCC_DeclFlags *>(orig);
+		arc.Node(node->Id);
+		arc.String(node->DeprecationMessage);
+		arc.Version(node->Version);
+		arc.Value(node->Flags);
+		break;
+	}
+
+	case AST_ClassCast:
+	{
+		auto node = static_cast<ZCC_ClassCast *>(orig);
+		SerializeExpression(arc, node);
+		arc.Name(node->ClassName);
+		arc.Node(node->Parameters);
+		break;
+	}
+
+	case AST_FunctionPtrCast:
+	{
+		auto node = static_cast<ZCC_FunctionPtrCast *>(orig);
+		SerializeExpression(arc, node);
+		arc.Node(node->PtrType);
+		arc.Node(node->Expr);
+		break;
+	}
+
+	case AST_StaticArrayStatement:
+	{
+		auto node = static_cast<ZCC_StaticArrayStatement *>(orig);
+		arc.Node(node->Type);
+		arc.Name(node->Id);
+		arc.Node(node->Values);
+		break;
+	}
+
+	case AST_Property:
+	{
+		auto node = static_cast<ZCC_Property *>(orig);
+		SerializeNamedNode(arc, node);
+		arc.Node(node->Body);
+		break;
+	}
+
+	case AST_FlagDef:
+	{
+		auto node = static_cast<ZCC_FlagDef *>(orig);
+		SerializeNamedNode(arc, node);
+		arc.Name(node->RefName);
+		arc.Value(node->BitValue);
+		break;
+	}
+
+	case AST_MixinDef:
+	{
+		auto node = static_cast<ZCC_MixinDef *>(orig);
+		SerializeNamedNode(arc, node);
+		arc.Node(node->Body);
+		arc.Value(node->MixinType);
+		break;
+	}
+
+	case AST_MixinStmt:
+		arc.Name(static_cast<ZCC_MixinStmt *>(orig)->MixinName);
+		break;
+
+	case AST_EnumTerminator:
+	case AST_StatePart:
+	case AST_StateStop:
+	case AST_StateWait:
+	case AST_StateFail:
+	case AST_StateLoop:
+	case AST_Statement:
+	case AST_ContinueStmt:
+	case AST_BreakStmt:
+		break;
+
+	default:
+		arc.Fail();
+		break;
+	}
+}
+
+// The only types the parser ever puts into the tree.
+static PType *GetCachedType(int index)
+{
+	switch (index)
+	{
+	case 1: return TypeString;
+	case 2: return TypeName;
+	case 3: return TypeSInt32;
+	case 4: return TypeUInt32;
+	case 5: return TypeBool;
+	case 6: return TypeFloat64;
+	case 7: return TypeFloat32;
+	case 8: return TypeNullPtr;
+	case 9: return TypeVector2;
+	case 10: return TypeVector3;
+	case 11: return TypeVector4;
+	case 12: return TypeError;
+	default: return nullptr;
+	}
+}
+static const int NUM_CACHED_TYPES = 13;
+
+//==========================================================================
+//
+// Collects every node reachable from the top node and numbers them.
+//
+//==========================================================================
+
+class FASTNodeCollector
+{
+public:
+	TArray<ZCC_TreeNode *> Nodes;
+	TMap<ZCC_TreeNode *, uint32_t> NodeIndex;
+	bool Failed = false;
+
+	void Collect(ZCC_TreeNode *top)
+	{
+		Add(top);
+		for (unsigned i = 0; i < Nodes.Size() && !Failed; i++)
+		{
+			SerializeNode(*this, Nodes[i]);
+		}
+	}
+
+	template<class T> void Node(T *&node) { Add(node); }
+	template<class T> void Value(T &) {}
+	template<class T> void Null(T *&) {}
+	void Name(ENamedName &) {}
+	void Name(int &) {}
+	void String(FString *&) {}
+	void Lump(int &) {}
+	void Float(double &) {}
+	void Type(PType *&) {}
+	void Version(VersionInfo &) {}
+	void Fail() { Failed = true; }
+
+private:
+	void Add(ZCC_TreeNode *node)
+	{
+		if (node != nullptr && NodeIndex.CheckKey(node) == nullptr)
+		{
+			NodeIndex.Insert(node, Nodes.Size());
+			Nodes.Push(node);
+		}
+	}
+};
+
+//==========================================================================
+//
+// Writer
+//
+//==========================================================================
+
+class FASTCacheWriter
+{
+public:
+	FASTCacheWriter(FASTNodeCollector &collector, const TArray<FASTCacheLump> &lumps) : Collector(collector), Lumps(lumps) {}
+
+	TArray<uint8_t> Body;
+	TArray<FString> Strings;
+	TArray<FString> Names;
+	bool Failed = false;
+
+	template<class T> void Node(T *&node)
+	{
+		if (node == nullptr) WriteUInt32(0);
+		else WriteUInt32(*Collector.NodeIndex.CheckKey(node) + 1);
+	}
+
+	template<class T> void Value(T &v)
+	{
+		WriteUInt32((uint32_t)v);
+	}
+
+	template<class T> void Null(T *&p)
+	{
+		// Symbols and types get filled in by the compiler. They must not exist yet.
+		if (p != nullptr) Failed = true;
+	}
+
+	void Name(ENamedName &name)
+	{
+		int v = name;
+		Name(v);
+	}
+
+	void Name(int &name)
+	{
+		auto index = NameIndex.CheckKey(name);
+		if (index == nullptr)
+		{
+			index = &NameIndex.Insert(name, Names.Size());
+			Names.Push(FName(ENamedName(name)).GetChars());
+		}
+		WriteUInt32(*index);
+	}
+
+	void String(FString *&str)
+	{
+		if (str == nullptr)
+		{
+			WriteUInt32(0);
+			return;
+		}
+		auto index = StringIndex.CheckKey(str);
+		if (index == nullptr)
+		{
+			index = &StringIndex.Insert(str, Strings.Size() + 1);
+			Strings.Push(*str);
+		}
+		WriteUInt32(*index);
+	}
+
+	void Lump(int &lump)
+	{
+		for (unsigned i = 0; i < Lumps.Size(); i++)
+		{
+			if (Lumps[i].Lump == lump)
+			{
+				WriteUInt32(i);
+				return;
+			}
+		}
+		Failed = true;
+	}
+
+	void Float(double &v)
+	{
+		Write(&v, sizeof(double));
+	}
+
+	void Type(PType *&type)
+	{
+		for (int i = 0; i < NUM_CACHED_TYPES; i++)
+		{
+			if (GetCachedType(i) == type)
+			{
+				WriteUInt32(i);
+				return;
+			}
+		}
+		Failed = true;
+	}
+
+	void Version(VersionInfo &v)
+	{
+		WriteUInt32(v.major);
+		WriteUInt32(v.minor);
+		WriteUInt32(v.revision);
+	}
+
+	void Fail() { Failed = true; }
+
+	void WriteUInt32(uint32_t v)
+	{
+		Write(&v, 4);
+	}
+
+	void Write(const void *data, size_t size)
+	{
+		auto pos = Body.Reserve((unsigned)size);
+		memcpy(&Body[pos], data, size);
+	}
+
+private:
+	FASTNodeCollector &Collector;
+	const TArray<FASTCacheLump> &Lumps;
+	TMap<FString *, uint32_t> StringIndex;
+	TMap<int, uint32_t> NameIndex;
+};
+
+//==========================================================================
+//
+// Reader
+//
+//==========================================================================
+
+class FASTCacheReader
+{
+public:
+	FASTCacheReader(const TArray<uint8_t> &data) : Data(data) {}
+
+	TArray<ZCC_TreeNode *> Nodes;
+	TArray<FString *> Strings;
+	TArray<int> Names;
+	TArray<int> Lumps;
+
+	template<class T> void Node(T *&node)
+	{
+		uint32_t index = ReadUInt32();
+		if (index > Nodes.Size()) throw CRecoverableError("bad node index");
+		node = index == 0 ? nullptr : static_cast<T *>(Nodes[index - 1]);
+	}
+
+	template<class T> void Value(T &v)
+	{
+		v = (T)ReadUInt32();
+	}
+
+	template<class T> void Null(T *&p)
+	{
+		p = nullptr;
+	}
+
+	void Name(ENamedName &name)
+	{
+		int v;
+		Name(v);
+		name = ENamedName(v);
+	}
+
+	void Name(int &name)
+	{
+		uint32_t index = ReadUInt32();
+		if (index >= Names.Size()) throw CRecoverableError("bad name index");
+		name = Names[index];
+	}
+
+	void String(FString *&str)
+	{
+		uint32_t index = ReadUInt32();
+		if (index > Strings.Size()) throw CRecoverableError("bad string index");
+		str = index == 0 ? nullptr : Strings[index - 1];
+	}
+
+	void Lump(int &lump)
+	{
+		uint32_t index = ReadUInt32();
+		if (index >= Lumps.Size()) throw CRecoverableError("bad lump index");
+		lump = Lumps[index];
+	}
+
+	void Float(double &v)
+	{
+		Read(&v, sizeof(double));
+	}
+
+	void Type(PType *&type)
+	{
+		type = GetCachedType(ReadUInt32());
+	}
+
+	void Version(VersionInfo &v)
+	{
+		v.major = (uint16_t)ReadUInt32();
+		v.minor = (uint16_t)ReadUInt32();
+		v.revision = ReadUInt32();
+	}
+
+	void Fail()
+	{
+		throw CRecoverableError("bad node type");
+	}
+
+	uint32_t ReadUInt32()
+	{
+		uint32_t v;
+		Read(&v, 4);
+		return v;
+	}
+
+	FString ReadString()
+	{
+		uint32_t len = ReadUInt32();
+		if (len > Data.Size() - Pos) throw CRecoverableError("unexpected end of file");
+		FString s((const char *)&Data[Pos], len);
+		Pos += len;
+		return s;
+	}
+
+	void Read(void *dest, size_t size)
+	{
+		if (size > Data.Size() - Pos) throw CRecoverableError("unexpected end of file");
+		memcpy(dest, &Data[Pos], size);
+		Pos += (unsigned)size;
+	}
+
+private:
+	const TArray<uint8_t> &Data;
+	unsigned Pos = 0;
+};
+
+static void WriteString(TArray<uint8_t> &out, const FString &s)
+{
+	uint32_t len = s.Len();
+	auto pos = out.Reserve(4 + len);
+	memcpy(&out[pos], &len, 4);
+	memcpy(&out[pos + 4], s.GetChars(), len);
+}
+
+static void WriteUInt32(TArray<uint8_t> &out, uint32_t v)
+{
+	auto pos = out.Reserve(4);
+	memcpy(&out[pos], &v, 4);
+}
+
+//==========================================================================
+//
+// ZCC_SaveASTCache
+//
+// Called after a script was parsed without errors.
+//
+//==========================================================================
+
+void ZCC_SaveASTCache(int baselump, const TArray<FString> &includes, ZCC_AST &ast)
+{
+	TArray<FASTCacheLump> lumps;
+	lumps.Reserve(1);
+	if (!SetupCacheLump(lumps[0], fileSystem.GetFileFullName(baselump), baselump))
+		return;
+
+	for (auto &name : includes)
+	{
+		FASTCacheLump &entry = lumps[lumps.Reserve(1)];
+		if (!SetupCacheLump(entry, name, fileSystem.CheckNumForFullName(name.GetChars(), true)))
+			return;
+	}
+
+	FASTNodeCollector collector;
+	collector.Collect(ast.TopNode);
+	if (collector.Failed)
+		return;
+
+	FASTCacheWriter writer(collector, lumps);
+	for (auto node : collector.Nodes)
+	{
+		SerializeNode(writer, node);
+	}
+	if (writer.Failed)
+		return;
+
+	TArray<uint8_t> out;
+	out.Reserve(4);
+	memcpy(out.Data(), "ZAST", 4);
+	WriteUInt32(out, ASTCACHE_VERSION);
+	WriteString(out, GetEngineKey());
+
+	WriteUInt32(out, lumps.Size());
+	for (auto &lump : lumps)
+	{
+		WriteString(out, lump.Name);
+		WriteString(out, lump.Path);
+		memcpy(&out[out.Reserve(16)], lump.Checksum, 16);
+	}
+
+	WriteUInt32(out, ast.ParseVersion.major);
+	WriteUInt32(out, ast.ParseVersion.minor);
+	WriteUInt32(out, ast.ParseVersion.revision);
+
+	WriteUInt32(out, writer.Strings.Size());
+	for (auto &s : writer.Strings) WriteString(out, s);
+
+	WriteUInt32(out, writer.Names.Size());
+	for (auto &s : writer.Names) WriteString(out, s);
+
+	WriteUInt32(out, collector.Nodes.Size());
+	for (auto node : collector.Nodes) out.Push((uint8_t)node->NodeType);
+
+	out.Append(writer.Body);
+	memcpy(&out[out.Reserve(4)], "ZEND", 4);
+
+	FString path = GetCacheFileName(baselump, true);
+	std::unique_ptr<FileWriter> fw(FileWriter::Open(path.GetChars()));
+	if (fw == nullptr || fw->Write(out.Data(), out.Size()) != out.Size())
+	{
+		DPrintf(DMSG_WARNING, "Unable to write script cache %s\n", path.GetChars());
+	}
+}
+
+//==========================================================================
+//
+// ZCC_LoadASTCache
+//
+// Replaces parsing of the script if a cached tree for identical source
+// exists. Returns false if the script needs to be parsed.
+//
+//==========================================================================
+
+bool ZCC_LoadASTCache(int baselump, ZCC_AST &ast)
+{
+	FString path = GetCacheFileName(baselump, false);
+	FileReader fr;
+	if (!fr.OpenFile(path.GetChars()))
+		return false;
+
+	TArray<uint8_t> data;
+	data.Resize((unsigned)fr.GetLength());
+	if (fr.Read(data.Data(), data.Size()) != (FileReader::Size)data.Size())
+		return false;
+
+	if (data.Size() < 8 || memcmp(data.Data(), "ZAST", 4) || memcmp(&data[data.Size() - 4], "ZEND", 4))
+		return false;
+
+	FASTCacheReader reader(data);
+	try
+	{
+		char magic[4];
+		reader.Read(magic, 4);
+		if (reader.ReadUInt32() != ASTCACHE_VERSION || reader.ReadString().Compare(GetEngineKey()) != 0)
+			return false;
+
+		// Every lump that went into the tree must still resolve to the same file with the same content.
+		auto fileno = fileSystem.GetFileContainer(baselump);
+		uint32_t numlumps = reader.ReadUInt32();
+		for (uint32_t i = 0; i < numlumps; i++)
+		{
+			FString name = reader.ReadString();
+			FString fullpath = reader.ReadString();
+			uint8_t checksum[16], current[16];
+			reader.Read(checksum, 16);
+
+			int lump = i == 0 ? baselump : fileSystem.CheckNumForFullName(name.GetChars(), true);
+			if (lump < 0 || fullpath.Compare(fileSystem.GetFileFullPath(lump).c_str()) != 0)
+				return false;
+			// A mod overriding a core include is an error that only the real parser reports.
+			if (fileno == 0 && fileSystem.GetFileContainer(lump) != 0)
+				return false;
+			GetLumpChecksum(lump, current);
+			if (memcmp(checksum, current, 16))
+				return false;
+			reader.Lumps.Push(lump);
+		}
+
+		VersionInfo version;
+		reader.Version(version);
+
+		uint32_t numstrings = reader.ReadUInt32();
+		for (uint32_t i = 0; i < numstrings; i++)
+		{
+			reader.Strings.Push(ast.Strings.Alloc(reader.ReadString()));
+		}
+
+		uint32_t numnames = reader.ReadUInt32();
+		for (uint32_t i = 0; i < numnames; i++)
+		{
+			reader.Names.Push(FName(reader.ReadString().GetChars()).GetIndex());
+		}
+
+		uint32_t numnodes = reader.ReadUInt32();
+		if (numnodes == 0)
+			return false;
+		for (uint32_t i = 0; i < numnodes; i++)
+		{
+			uint8_t type;
+			reader.Read(&type, 1);
+			size_t size = type < NUM_AST_NODE_TYPES ? GetNodeSize(EZCCTreeNodeType(type)) : 0;
+			if (size == 0)
+				return false;
+			reader.Nodes.Push(ast.InitNode(size, EZCCTreeNodeType(type), nullptr));
+		}
+		for (auto node : reader.Nodes)
+		{
+			SerializeNode(reader, node);
+		}
+
+		ast.ParseVersion = version;
+		ast.TopNode = reader.Nodes[0];
+		return true;
+	}
+	catch (const CRecoverableError &)
+	{
+		// Damaged cache file. Just parse the script again.
+		return false;
+	}
+}
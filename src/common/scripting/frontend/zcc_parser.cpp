@@ -36,6 +36,7 @@
 #include "filesystem.h"
 #include "cmdlib.h"
 #include "m_argv.h"
+#include "c_cvars.h"
 #include "v_text.h"
 #include "version.h"
 #include "zcc_parser.h"
@@ -45,6 +46,10 @@
 TArray<FString> Includes;
 TArray<FScriptPosition> IncludeLocs;
 
+// Only the parsed AST is cached, the compiler still runs on every start. Off by default,
+// since checking the cache means hashing all script lumps on each launch.
+CVAR(Bool, vm_cachescripts, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+
 static FString ResolveIncludePath(const FString &path,const FString &lumpname){
 	if (path.IndexOf("./") == 0 || path.IndexOf("../") == 0) // relative path resolving
 	{
@@ -409,15 +414,14 @@ parse_end:
 
 //**--------------------------------------------------------------------------
 
-PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
+static void ParseScriptSource(const int baselump, ZCCParseState &state)
 {
 	FScanner sc;
 	void *parser;
 	ZCCToken value;
 	int lumpnum = baselump;
 	auto fileno = fileSystem.GetFileContainer(lumpnum);
-
-	state.FileNo = fileno;
+	int warnings = FScriptPosition::WarnCounter;
 
 	if (TokenMap.CountUsed() == 0)
 	{
@@ -498,7 +502,7 @@ PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
 			ParseSingleFile(nullptr, nullptr, lumpnum, parser, state);
 		}
 	}
-	Includes.Clear();
+	TArray<FString> parsedIncludes = std::move(Includes);
 	Includes.ShrinkToFit();
 	IncludeLocs.Clear();
 	IncludeLocs.ShrinkToFit();
@@ -521,6 +525,22 @@ PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
 	}
 #endif
 
+	// Scripts that produced warnings are not cached so that the warnings get shown again next time.
+	if (vm_cachescripts && FScriptPosition::WarnCounter == warnings)
+	{
+		ZCC_SaveASTCache(baselump, parsedIncludes, state);
+	}
+}
+
+PNamespace *ParseOneScript(const int baselump, ZCCParseState &state)
+{
+	state.FileNo = fileSystem.GetFileContainer(baselump);
+
+	if (!vm_cachescripts || !ZCC_LoadASTCache(baselump, state))
+	{
+		ParseScriptSource(baselump, state);
+	}
+
 	// Make a dump of the AST before running the compiler for diagnostic purposes.
 	if (Args->CheckParm("-dumpast"))
 	{
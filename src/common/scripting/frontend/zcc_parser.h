@@ -699,4 +699,8 @@ ZCC_TreeNode *TreeNodeDeepCopy(ZCC_AST *ast, ZCC_TreeNode *orig, bool copySiblin
 // Main entry point for the parser. Returns some data needed by the compiler.
 PNamespace* ParseOneScript(const int baselump, ZCCParseState& state);
 
+// Persistent cache for parsed scripts, see zcc_cache.cpp.
+bool ZCC_LoadASTCache(int baselump, ZCC_AST &ast);
+void ZCC_SaveASTCache(int baselump, const TArray<FString> &includes, ZCC_AST &ast);
+
 #endif
@@ -10,15 +10,10 @@ extern PStruct* TypeVector4;
 extern PStruct* TypeQuaternion;
 extern PStruct* TypeFQuaternion;
 
-static void OutputJitLog(const asmjit::StringLogger &logger);
-
-JitFuncPtr JitCompile(VMScriptFunction *sfunc)
+// Compiles the function without printing anything, so it can run on any thread.
+// A recoverable error is returned with the compiler log, everything else goes to the caller.
+JitFuncPtr JitCompileBackground(VMScriptFunction *sfunc, FString &error)
 {
-#if 0
-	if (strcmp(sfunc->PrintableName, "StatusScreen.drawNum") != 0)
-		return nullptr;
-#endif
-
 	using namespace asmjit;
 	StringLogger logger;
 	try
@@ -34,12 +29,26 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 	}
 	catch (const CRecoverableError &e)
 	{
-		OutputJitLog(logger);
-		Printf("%s: Unexpected JIT error: %s\n",sfunc->PrintableName, e.what());
+		error = logger.getString();
+		error.AppendFormat("%s: Unexpected JIT error: %s\n", sfunc->PrintableName, e.what());
 		return nullptr;
 	}
 }
 
+JitFuncPtr JitCompile(VMScriptFunction *sfunc)
+{
+#if 0
+	if (strcmp(sfunc->PrintableName, "StatusScreen.drawNum") != 0)
+		return nullptr;
+#endif
+
+	FString error;
+	JitFuncPtr code = JitCompileBackground(sfunc, error);
+	if (error.IsNotEmpty())
+		OutputJitLog(error.GetChars());
+	return code;
+}
+
 void JitDumpLog(FILE *file, VMScriptFunction *sfunc)
 {
 	using namespace asmjit;
@@ -77,10 +86,10 @@ void JitDumpLog(FILE *file, VMScriptFunction *sfunc)
 	}
 }
 
-static void OutputJitLog(const asmjit::StringLogger &logger)
+void OutputJitLog(const char *log)
 {
 	// Write line by line since I_FatalError seems to cut off long strings
-	const char *pos = logger.getString();
+	const char *pos = log;
 	const char *end = pos;
 	while (*end)
 	{
@@ -141,8 +150,10 @@ asmjit::CCFunc *JitCompiler::Codegen()
 		}
 
 		labels[i].cursor = cc.getCursor();
+		spillCursor = labels[i].cursor;
 		ResetTemp();
 		EmitOpcode();
+		StoreSpilledRegisters();
 
 		pc++;
 	}
@@ -213,7 +224,9 @@ void JitCompiler::CheckVMFrame()
 		vmframe = cc.newIntPtr("vmframe");
 		cc.lea(vmframe, vmstack);
 
-		cc.setCursor(cursor);
+		// If this was called right at the frame setup, the code that follows must come after the lea.
+		if (cursor != vmframeCursor)
+			cc.setCursor(cursor);
 		vmframeAllocated = true;
 	}
 }
@@ -274,6 +287,7 @@ void JitCompiler::Setup()
 
 	CreateRegisters();
 	IncrementVMCalls();
+	EmitProfilerSample();
 	SetupFrame();
 }
 
@@ -304,6 +318,9 @@ void JitCompiler::SetupSimpleFrame()
 	// This is a simple frame with no constructors or destructors. Allocate it on the stack ourselves.
 
 	vmframeCursor = cc.getCursor();
+	if (spillRegisters)
+		CheckVMFrame();
+	spillCursor = cc.getCursor();
 
 	int argsPos = 0;
 	int regd = 0, regf = 0, rega = 0;
@@ -348,6 +365,8 @@ void JitCompiler::SetupSimpleFrame()
 		{
 			cc.mov(regA[rega++], x86::ptr(args, argsPos++ * sizeof(VMValue) + offsetof(VMValue, a)));
 		}
+		StoreSpilledRegisters();
+		ResetTemp();
 	}
 
 	const char *errorDetails = nullptr;
@@ -375,13 +394,28 @@ void JitCompiler::SetupSimpleFrame()
 	}
 
 	for (int i = regd; i < sfunc->NumRegD; i++)
-		cc.xor_(regD[i], regD[i]);
+	{
+		if (regD.IsSpilled(i))
+			cc.mov(x86::dword_ptr(vmframe, offsetD + i * sizeof(int32_t)), 0);
+		else
+			cc.xor_(regD[i], regD[i]);
+	}
 
 	for (int i = regf; i < sfunc->NumRegF; i++)
-		cc.xorpd(regF[i], regF[i]);
+	{
+		if (regF.IsSpilled(i))
+			cc.mov(x86::qword_ptr(vmframe, offsetF + i * sizeof(double)), 0);
+		else
+			cc.xorpd(regF[i], regF[i]);
+	}
 
 	for (int i = rega; i < sfunc->NumRegA; i++)
-		cc.xor_(regA[i], regA[i]);
+	{
+		if (regA.IsSpilled(i))
+			cc.mov(x86::qword_ptr(vmframe, offsetA + i * sizeof(void*)), 0);
+		else
+			cc.xor_(regA[i], regA[i]);
+	}
 }
 
 static VMFrameStack *CreateFullVMFrame(VMScriptFunction *func, VMValue *args, int numargs)
@@ -408,16 +442,17 @@ void JitCompiler::SetupFullVMFrame()
 	cc.mov(vmframe, x86::ptr(vmframe, VMFrameStack::OffsetLastFrame())); // Blocks->LastFrame
 	vmframeAllocated = true;
 
-	for (int i = 0; i < sfunc->NumRegD; i++)
+	// Spilled registers are already where they belong.
+	for (int i = 0; i < sfunc->NumRegD && !regD.IsSpilled(i); i++)
 		cc.mov(regD[i], x86::dword_ptr(vmframe, offsetD + i * sizeof(int32_t)));
 
-	for (int i = 0; i < sfunc->NumRegF; i++)
+	for (int i = 0; i < sfunc->NumRegF && !regF.IsSpilled(i); i++)
 		cc.movsd(regF[i], x86::qword_ptr(vmframe, offsetF + i * sizeof(double)));
 
-	for (int i = 0; i < sfunc->NumRegS; i++)
+	for (int i = 0; i < sfunc->NumRegS && !regS.IsSpilled(i); i++)
 		cc.lea(regS[i], x86::ptr(vmframe, offsetS + i * sizeof(FString)));
 
-	for (int i = 0; i < sfunc->NumRegA; i++)
+	for (int i = 0; i < sfunc->NumRegA && !regA.IsSpilled(i); i++)
 		cc.mov(regA[i], x86::ptr(vmframe, offsetA + i * sizeof(void*)));
 }
 
@@ -446,36 +481,134 @@ void JitCompiler::IncrementVMCalls()
 	cc.mov(asmjit::x86::dword_ptr(vmcallsptr), vmcalls);
 }
 
+void JitCompiler::EmitProfilerSample()
+{
+	// Safepoint for the sampling profiler. Only the flag test is executed while it isn't running.
+	auto flagptr = newTempIntPtr();
+	auto skip = cc.newLabel();
+	cc.mov(flagptr, asmjit::imm_ptr(&VMProfilerSampleRequested));
+	cc.cmp(asmjit::x86::dword_ptr(flagptr), 0);
+	cc.je(skip);
+	auto call = CreateCall<void, VMScriptFunction *>(VMProfilerSampleJit);
+	call->setArg(0, asmjit::imm_ptr(sfunc));
+	cc.bind(skip);
+}
+
 void JitCompiler::CreateRegisters()
 {
-	regD.Resize(sfunc->NumRegD);
-	regF.Resize(sfunc->NumRegF);
-	regA.Resize(sfunc->NumRegA);
-	regS.Resize(sfunc->NumRegS);
+	// Asmjit has a 256 register limit and the temporaries need some of them as well.
+	// Above that only a share of each register type is kept in asmjit registers. The registers
+	// with the lowest numbers hold arguments and outer locals, so they are the ones that stay.
+	const int maxCached = 199;
+	int numCachedD = sfunc->NumRegD, numCachedF = sfunc->NumRegF, numCachedA = sfunc->NumRegA, numCachedS = sfunc->NumRegS;
+	int total = sfunc->NumRegD + sfunc->NumRegF + sfunc->NumRegA + sfunc->NumRegS;
+	spillRegisters = total > maxCached;
+	if (spillRegisters)
+	{
+		numCachedD = sfunc->NumRegD * maxCached / total;
+		numCachedF = sfunc->NumRegF * maxCached / total;
+		numCachedA = sfunc->NumRegA * maxCached / total;
+		numCachedS = sfunc->NumRegS * maxCached / total;
+	}
 
-	for (int i = 0; i < sfunc->NumRegD; i++)
+	regD.Init(this, REGT_INT, sfunc->NumRegD, numCachedD);
+	regF.Init(this, REGT_FLOAT, sfunc->NumRegF, numCachedF);
+	regA.Init(this, REGT_POINTER, sfunc->NumRegA, numCachedA);
+	regS.Init(this, REGT_STRING, sfunc->NumRegS, numCachedS);
+
+	for (int i = 0; i < numCachedD; i++)
 	{
 		regname.Format("regD%d", i);
-		regD[i] = cc.newInt32(regname.GetChars());
+		regD.Regs[i] = cc.newInt32(regname.GetChars());
 	}
 
-	for (int i = 0; i < sfunc->NumRegF; i++)
+	for (int i = 0; i < numCachedF; i++)
 	{
 		regname.Format("regF%d", i);
-		regF[i] = cc.newXmmSd(regname.GetChars());
+		regF.Regs[i] = cc.newXmmSd(regname.GetChars());
 	}
 
-	for (int i = 0; i < sfunc->NumRegS; i++)
+	for (int i = 0; i < numCachedS; i++)
 	{
 		regname.Format("regS%d", i);
-		regS[i] = cc.newIntPtr(regname.GetChars());
+		regS.Regs[i] = cc.newIntPtr(regname.GetChars());
 	}
 
-	for (int i = 0; i < sfunc->NumRegA; i++)
+	for (int i = 0; i < numCachedA; i++)
 	{
 		regname.Format("regA%d", i);
-		regA[i] = cc.newIntPtr(regname.GetChars());
+		regA.Regs[i] = cc.newIntPtr(regname.GetChars());
+	}
+}
+
+void JitCompiler::LoadSpilledRegister(int regtype, int index)
+{
+	using namespace asmjit;
+
+	// The load goes to the start of the current opcode, so it happens no matter
+	// which code path inside the opcode is the first to use the register.
+	auto cursor = cc.getCursor();
+	bool atStart = cursor == spillCursor;
+	cc.setCursor(spillCursor);
+
+	switch (regtype)
+	{
+	case REGT_INT:
+		regD.Regs[index] = newSpillInt32();
+		regD.Loaded[index] = true;
+		cc.mov(regD.Regs[index], x86::dword_ptr(vmframe, offsetD + index * sizeof(int32_t)));
+		break;
+	case REGT_FLOAT:
+		regF.Regs[index] = newSpillXmmSd();
+		regF.Loaded[index] = true;
+		cc.movsd(regF.Regs[index], x86::qword_ptr(vmframe, offsetF + index * sizeof(double)));
+		break;
+	case REGT_POINTER:
+		regA.Regs[index] = newSpillIntPtr();
+		regA.Loaded[index] = true;
+		cc.mov(regA.Regs[index], x86::ptr(vmframe, offsetA + index * sizeof(void*)));
+		break;
+	case REGT_STRING:
+		regS.Regs[index] = newSpillIntPtr();
+		regS.Loaded[index] = true;
+		cc.lea(regS.Regs[index], x86::ptr(vmframe, offsetS + index * sizeof(FString)));
+		break;
+	}
+	loadedSpills.Push(std::make_pair(regtype, index));
+
+	spillCursor = cc.getCursor();
+	cc.setCursor(atStart ? spillCursor : cursor);
+}
+
+void JitCompiler::StoreSpilledRegisters()
+{
+	using namespace asmjit;
+
+	for (auto &spill : loadedSpills)
+	{
+		int index = spill.second;
+		switch (spill.first)
+		{
+		case REGT_INT:
+			cc.mov(x86::dword_ptr(vmframe, offsetD + index * sizeof(int32_t)), regD.Regs[index]);
+			regD.Loaded[index] = false;
+			break;
+		case REGT_FLOAT:
+			cc.movsd(x86::qword_ptr(vmframe, offsetF + index * sizeof(double)), regF.Regs[index]);
+			regF.Loaded[index] = false;
+			break;
+		case REGT_POINTER:
+			cc.mov(x86::ptr(vmframe, offsetA + index * sizeof(void*)), regA.Regs[index]);
+			regA.Loaded[index] = false;
+			break;
+		case REGT_STRING:
+			// Only the address of the string is in the register. Nothing to write back.
+			regS.Loaded[index] = false;
+			break;
+		}
 	}
+	loadedSpills.Clear();
+	spillCursor = cc.getCursor();
 }
 
 void JitCompiler::EmitNullPointerThrow(int index, EVMAbortException reason)
@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include "vmintern.h"
@@ -6,3 +5,28 @@
 JitFuncPtr JitCompile(VMScriptFunction *func);
 void JitDumpLog(FILE *file, VMScriptFunction *func);
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int maxFrames = -1);
+
+// Script functions and line numbers of the JIT frames on the current call stack, innermost first.
+int JitCaptureScriptFrames(VMScriptFunction **funcs, int *lines, int maxFrames);
+
+// Background compilation for the tiered JIT. Functions are queued from the game thread
+// and compiled on a worker thread. The finished code is only installed into
+// VMScriptFunction::ScriptCall by JitInstallCompiled, which must run on the game thread.
+void JitQueueCompile(VMScriptFunction *func);
+void JitInstallCompiled();
+void JitStopBackgroundCompiler();
+
+// Compiles a whole list of functions at once, spread over numThreads threads. Used by vm_jit_aot.
+void JitCompileParallel(const TArray<VMScriptFunction *> &functions, TArray<JitFuncPtr> &code, int numThreads);
+
+struct FJitTierStats
+{
+	int Interpreted = 0;
+	int Queued = 0;
+	int Compiled = 0;
+	int Failed = 0;
+};
+extern FJitTierStats JitTierStats;
+
+// Hit rate of the inline caches at virtual call sites in JIT code.
+void JitGetCallCacheStats(int &sites, uint64_t &hits, uint64_t &misses);
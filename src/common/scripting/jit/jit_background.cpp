@@ -0,0 +1,214 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <vector>
+#include "jit.h"
+#include "jitintern.h"
+#include "printf.h"
+
+FJitTierStats JitTierStats;
+
+struct JitCompileResult
+{
+	VMScriptFunction *Func = nullptr;
+	JitFuncPtr Code = nullptr;
+	FString Error;
+	std::exception_ptr Fatal;	// anything JitCompileBackground does not handle itself
+};
+
+// Compiles queued script functions on a worker thread.
+//
+// The worker never touches VMScriptFunction::ScriptCall. Finished functions are collected
+// and installed by the game thread, so the switch from the VM to native code happens
+// between two calls and never while the VM is reading the pointer. Fatal errors are
+// passed on the same way and rethrown by the game thread.
+class JitBackgroundCompiler
+{
+public:
+	~JitBackgroundCompiler()
+	{
+		Stop();
+	}
+
+	void Queue(VMScriptFunction *func)
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		if (!Worker.joinable())
+		{
+			StopRequested = false;
+			Worker = std::thread([this]() { WorkerMain(); });
+		}
+		Pending.Push(func);
+		lock.unlock();
+		WorkAvailable.notify_one();
+	}
+
+	void Install()
+	{
+		if (!ResultsReady.load(std::memory_order_acquire))
+			return;
+
+		TArray<JitCompileResult> results;
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			results = std::move(Finished);
+			ResultsReady.store(false, std::memory_order_relaxed);
+		}
+
+		for (auto &result : results)
+		{
+			if (result.Fatal)
+				std::rethrow_exception(result.Fatal);
+
+			VMScriptFunction *func = result.Func;
+			JitTierStats.Queued--;
+			if (result.Code)
+			{
+				func->ScriptCall = result.Code;
+				func->JitState = VMScriptFunction::JitState_Compiled;
+				JitTierStats.Compiled++;
+			}
+			else
+			{
+				if (result.Error.IsNotEmpty())
+					OutputJitLog(result.Error.GetChars());
+				func->ScriptCall = VMExec;
+				func->JitState = VMScriptFunction::JitState_Failed;
+				JitTierStats.Failed++;
+			}
+		}
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			StopRequested = true;
+		}
+		WorkAvailable.notify_all();
+		if (Worker.joinable())
+			Worker.join();
+
+		// Whatever did not get installed yet is dropped. This only happens when the VM is shut down.
+		Pending.Clear();
+		PendingPos = 0;
+		Finished.Clear();
+		ResultsReady.store(false, std::memory_order_relaxed);
+	}
+
+private:
+	void WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (true)
+		{
+			WorkAvailable.wait(lock, [this]() { return StopRequested || PendingPos < Pending.Size(); });
+			if (StopRequested)
+				break;
+
+			JitCompileResult result;
+			result.Func = Pending[PendingPos++];
+			if (PendingPos == Pending.Size())
+			{
+				Pending.Clear();
+				PendingPos = 0;
+			}
+			lock.unlock();
+
+			try
+			{
+				result.Code = JitCompileBackground(result.Func, result.Error);
+			}
+			catch (...)
+			{
+				result.Fatal = std::current_exception();
+			}
+
+			lock.lock();
+			Finished.Push(std::move(result));
+			ResultsReady.store(true, std::memory_order_release);
+		}
+	}
+
+	std::thread Worker;
+	std::mutex Mutex;
+	std::condition_variable WorkAvailable;
+	TArray<VMScriptFunction *> Pending;
+	unsigned PendingPos = 0;
+	TArray<JitCompileResult> Finished;
+	std::atomic<bool> ResultsReady { false };
+	bool StopRequested = false;
+};
+
+static JitBackgroundCompiler BackgroundCompiler;
+
+void JitQueueCompile(VMScriptFunction *func)
+{
+	BackgroundCompiler.Queue(func);
+}
+
+void JitInstallCompiled()
+{
+	BackgroundCompiler.Install();
+}
+
+void JitStopBackgroundCompiler()
+{
+	BackgroundCompiler.Stop();
+	JitTierStats = {};
+}
+
+// Compiles all functions in the list on numThreads threads, the calling thread included.
+// Each function gets its own CodeHolder, so the output is the same as compiling them one after another.
+// Errors are printed afterwards in list order to keep the log readable. A fatal error stops
+// all threads and the first one is rethrown on the calling thread once they have finished.
+void JitCompileParallel(const TArray<VMScriptFunction *> &functions, TArray<JitFuncPtr> &code, int numThreads)
+{
+	code.Resize(functions.Size());
+	TArray<FString> errors;
+	errors.Resize(functions.Size());
+
+	std::atomic<unsigned> next { 0 };
+	std::mutex fatalMutex;
+	std::exception_ptr fatal;
+	auto worker = [&]()
+	{
+		while (true)
+		{
+			unsigned index = next.fetch_add(1, std::memory_order_relaxed);
+			if (index >= functions.Size())
+				break;
+			try
+			{
+				code[index] = JitCompileBackground(functions[index], errors[index]);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(fatalMutex);
+				if (!fatal)
+					fatal = std::current_exception();
+				next.store(functions.Size(), std::memory_order_relaxed);
+				break;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	numThreads = min<int>(numThreads, functions.Size());
+	for (int i = 1; i < numThreads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &thread : threads)
+		thread.join();
+
+	if (fatal)
+		std::rethrow_exception(fatal);
+
+	for (auto &error : errors)
+	{
+		if (error.IsNotEmpty())
+			Printf("%s", error.GetChars());
+	}
+}
@@ -2,6 +2,11 @@
 #include "jitintern.h"
 #include <map>
 #include <memory>
+#include <mutex>
+#include "c_cvars.h"
+
+EXTERN_CVAR(Bool, vm_jit_callcache)
+EXTERN_CVAR(Bool, vm_jit_callstats)
 
 void JitCompiler::EmitPARAM()
 {
@@ -25,8 +30,76 @@ void JitCompiler::EmitVTBL()
 	// This instruction is handled in the CALL/CALL_K instruction following it
 }
 
+// Inline cache for a single virtual call site. The generated code compares the class of
+// the object with the classes seen last at this site and only goes to the vtable if none
+// of them match. Virtual tables never change while JIT code exists, so entries never go stale.
+// Hits and Misses are only counted if vm_jit_callstats was on when the site got compiled,
+// so that a hit does not write to memory shared by all threads running the code.
+struct JitCallCache
+{
+	enum { NumEntries = 2 };
+
+	PClass *Classes[NumEntries] = {};
+	VMFunction *Targets[NumEntries] = {};
+	uint64_t Hits = 0;
+	uint64_t Misses = 0;
+	int VIndex = 0;
+	int NextEntry = 0;
+};
+
+static std::vector<std::unique_ptr<JitCallCache>> CallCaches;
+static std::mutex CallCachesMutex;
+
+static JitCallCache *CreateCallCache(int vindex)
+{
+	std::lock_guard<std::mutex> lock(CallCachesMutex);
+	CallCaches.push_back(std::make_unique<JitCallCache>());
+	CallCaches.back()->VIndex = vindex;
+	return CallCaches.back().get();
+}
+
+void JitReleaseCallCaches()
+{
+	std::lock_guard<std::mutex> lock(CallCachesMutex);
+	CallCaches.clear();
+}
+
+void JitGetCallCacheStats(int &sites, uint64_t &hits, uint64_t &misses)
+{
+	std::lock_guard<std::mutex> lock(CallCachesMutex);
+	sites = (int)CallCaches.size();
+	hits = 0;
+	misses = 0;
+	for (auto &cache : CallCaches)
+	{
+		hits += cache->Hits;
+		misses += cache->Misses;
+	}
+}
+
+static VMFunction *ResolveVirtualCall(JitCallCache *cache, DObject *self)
+{
+	PClass *cls = self->GetClass();
+	VMFunction *func = cls->Virtuals[cache->VIndex];
+
+	// Entries get replaced round robin, so a site alternating between two classes stays cached.
+	int entry = cache->NextEntry;
+	cache->NextEntry = (entry + 1) % JitCallCache::NumEntries;
+	cache->Classes[entry] = cls;
+	cache->Targets[entry] = func;
+	return func;
+}
+
+static VMFunction *ResolveVirtualCallCounted(JitCallCache *cache, DObject *self)
+{
+	cache->Misses++;
+	return ResolveVirtualCall(cache, self);
+}
+
 void JitCompiler::EmitVtbl(const VMOP *op)
 {
+	using namespace asmjit;
+
 	int a = op->a;
 	int b = op->b;
 	int c = op->c;
@@ -35,9 +108,87 @@ void JitCompiler::EmitVtbl(const VMOP *op)
 	cc.test(regA[b], regA[b]);
 	cc.jz(label);
 
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[b], myoffsetof(DObject, Class)));
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[a], myoffsetof(PClass, Virtuals) + myoffsetof(FArray, Array)));
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[a], c * (int)sizeof(void*)));
+	if (!vm_jit_callcache)
+	{
+		cc.mov(regA[a], x86::qword_ptr(regA[b], myoffsetof(DObject, Class)));
+		cc.mov(regA[a], x86::qword_ptr(regA[a], myoffsetof(PClass, Virtuals) + myoffsetof(FArray, Array)));
+		cc.mov(regA[a], x86::qword_ptr(regA[a], c * (int)sizeof(void*)));
+		return;
+	}
+
+	JitCallCache *cache = CreateCallCache(c);
+	bool countstats = vm_jit_callstats;
+
+	auto cacheptr = newTempIntPtr();
+	auto cls = newTempIntPtr();
+	cc.mov(cacheptr, imm_ptr(cache));
+	cc.mov(cls, x86::qword_ptr(regA[b], myoffsetof(DObject, Class)));
+
+	Label hit = cc.newLabel();
+	Label done = cc.newLabel();
+	for (int i = 0; i < JitCallCache::NumEntries; i++)
+	{
+		Label next = cc.newLabel();
+		cc.cmp(cls, x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, Classes) + i * (int)sizeof(void*)));
+		cc.jne(next);
+		cc.mov(regA[a], x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, Targets) + i * (int)sizeof(void*)));
+		cc.jmp(hit);
+		cc.bind(next);
+	}
+
+	auto call = CreateCall<VMFunction *, JitCallCache *, DObject *>(countstats ? ResolveVirtualCallCounted : ResolveVirtualCall);
+	call->setRet(0, regA[a]);
+	call->setArg(0, cacheptr);
+	call->setArg(1, regA[b]);
+	cc.jmp(done);
+
+	cc.bind(hit);
+	if (countstats)
+	{
+		cc.inc(x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, Hits)));
+	}
+	cc.bind(done);
+}
+
+//==========================================================================
+//
+// Guarded direct calls
+//
+// The compiler records the function each virtual call was compiled against.
+// If that is a native function with a direct entry point, the call checks
+// whether the object's class still uses it and then calls it directly, the
+// same way CALL_K does, without going through VMValue parameters. Anything
+// else takes the regular path. Script functions are always called through
+// their ScriptCall, which may still change while this code exists.
+//
+//==========================================================================
+
+static VMNativeFunction *GetDirectTarget(VMScriptFunction *sfunc, const VMOP *vtbl, const TArray<const VMOP *> &params)
+{
+	unsigned index = unsigned(vtbl - sfunc->Code);
+	VMFunction *declared = nullptr;
+	for (auto &info : sfunc->VirtualCalls)
+	{
+		if (info.InstructionIndex == index)
+		{
+			declared = info.Declared;
+			break;
+		}
+	}
+	if (declared == nullptr || !(declared->VarFlags & VARF_Native))
+		return nullptr;
+
+	auto ntarget = static_cast<VMNativeFunction *>(declared);
+	if (ntarget->DirectNativeCall == nullptr)
+		return nullptr;
+
+	// Native direct calls do not support everything the VM calling convention does.
+	for (auto param : params)
+	{
+		if (param->op == OP_PARAM && (param->a & REGT_ADDROF) && (param->a & REGT_TYPE) != REGT_STRING)
+			return nullptr;
+	}
+	return ntarget;
 }
 
 void JitCompiler::EmitCALL()
@@ -56,6 +207,10 @@ void JitCompiler::EmitCALL_K()
 
 	if (ntarget && ntarget->DirectNativeCall)
 	{
+		if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
+		{
+			I_Error("Native direct member function calls not implemented\n");
+		}
 		EmitNativeCall(ntarget);
 	}
 	else
@@ -74,13 +229,41 @@ void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
 
 	CheckVMFrame();
 
+	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
+	{
+		const VMOP *vtbl = pc - 1;
+		EmitVtbl(vtbl);
+
+		VMNativeFunction *direct = vm_jit_callcache ? GetDirectTarget(sfunc, vtbl, ParamOpcodes) : nullptr;
+		if (direct != nullptr)
+		{
+			Label generic = cc.newLabel();
+			Label done = cc.newLabel();
+			TArray<const VMOP *> params = ParamOpcodes;	// EmitNativeCall clears these
+
+			cc.cmp(regA[vtbl->a], imm_ptr(direct));
+			cc.jne(generic);
+			EmitNativeCall(direct);
+			cc.jmp(done);
+
+			cc.bind(generic);
+			ParamOpcodes = std::move(params);
+			EmitVMCallBody(vmfunc, target);
+			cc.bind(done);
+			return;
+		}
+	}
+	EmitVMCallBody(vmfunc, target);
+}
+
+void JitCompiler::EmitVMCallBody(asmjit::X86Gp vmfunc, VMFunction *target)
+{
+	using namespace asmjit;
+
 	int numparams = StoreCallParams();
 	if (numparams != B)
 		I_Error("OP_CALL parameter count does not match the number of preceding OP_PARAM instructions");
 
-	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
-		EmitVtbl(pc - 1);
-
 	FillReturns(pc + 1, C);
 
 	X86Gp paramsptr = newTempIntPtr();
@@ -331,11 +514,6 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 {
 	using namespace asmjit;
 
-	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
-	{
-		I_Error("Native direct member function calls not implemented\n");
-	}
-
 	if (target->ImplicitArgs > 0)
 	{
 		auto label = EmitThrowExceptionLabel(X_READ_NIL);
@@ -590,6 +768,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 }
 
 static std::map<FString, std::unique_ptr<TArray<uint8_t>>> argsCache;
+static std::mutex argsCacheMutex;
 
 asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 {
@@ -712,8 +891,10 @@ asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 	}
 
 	// FuncSignature only keeps a pointer to its args array. Store a copy of each args array variant.
+	std::unique_lock<std::mutex> lock(argsCacheMutex);
 	std::unique_ptr<TArray<uint8_t>> &cachedArgs = argsCache[key];
 	if (!cachedArgs) cachedArgs.reset(new TArray<uint8_t>(args));
+	lock.unlock();
 
 	FuncSignature signature;
 	signature.init(CallConv::kIdHost, rettype, cachedArgs->Data(), cachedArgs->Size());
@@ -18,6 +18,10 @@ void JitCompiler::EmitTESTN()
 
 void JitCompiler::EmitJMP()
 {
+	// Loops without calls would never reach a safepoint otherwise.
+	if (JMPOFS(pc) < 0)
+		EmitProfilerSample();
+
 	auto dest = pc + JMPOFS(pc) + 1;
 	int i = (int)(ptrdiff_t)(dest - sfunc->Code);
 	cc.jmp(GetLabel(i));
@@ -1,5 +1,7 @@
 
 #include <memory>
+#include <algorithm>
+#include <mutex>
 #include "jit.h"
 #include "jitintern.h"
 
@@ -21,25 +23,27 @@ struct JitFuncInfo
 	TArray<JitLineInfo> LineInfo;
 	void *start;
 	void *end;
+	VMScriptFunction *func;
 };
 
 static TArray<JitFuncInfo> JitDebugInfo;
+static TArray<unsigned int> JitDebugInfoSorted;	// indices into JitDebugInfo ordered by start address
 static TArray<uint8_t*> JitBlocks;
 static TArray<uint8_t*> JitFrames;
 static size_t JitBlockPos = 0;
 static size_t JitBlockSize = 0;
 
+// Guards the code blocks and debug info above. Functions may be added from the background compiler threads.
+static std::mutex JitRuntimeMutex;
+
 asmjit::CodeInfo GetHostCodeInfo()
 {
-	static bool firstCall = true;
-	static asmjit::CodeInfo codeInfo;
-
-	if (firstCall)
+	// Initialized on first use in a thread safe way, as the background compiler calls this as well.
+	static const asmjit::CodeInfo codeInfo = []()
 	{
 		asmjit::JitRuntime rt;
-		codeInfo = rt.getCodeInfo();
-		firstCall = false;
-	}
+		return rt.getCodeInfo();
+	}();
 
 	return codeInfo;
 }
@@ -274,6 +278,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 	codeSize = (codeSize + 15) / 16 * 16;
 
+	std::lock_guard<std::mutex> lock(JitRuntimeMutex);
 	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize + functionTableSize);
 	if (!p)
 		return nullptr;
@@ -306,7 +311,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 	if (result == 0)
 		I_Error("RtlAddFunctionTable failed");
 
-	JitDebugInfo.Push({ FString(compiler->GetScriptFunction()->PrintableName), compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push({ FString(compiler->GetScriptFunction()->PrintableName), compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr, compiler->GetScriptFunction() });
 #endif
 
 	return p;
@@ -665,6 +670,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 	codeSize = (codeSize + 15) / 16 * 16;
 
+	std::lock_guard<std::mutex> lock(JitRuntimeMutex);
 	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize);
 	if (!p)
 		return nullptr;
@@ -730,7 +736,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 #endif
 	}
 
-	JitDebugInfo.Push({ compiler->GetScriptFunction()->PrintableName, compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push({ compiler->GetScriptFunction()->PrintableName, compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr, compiler->GetScriptFunction() });
 
 	return p;
 }
@@ -738,6 +744,9 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 void JitRelease()
 {
+	JitStopBackgroundCompiler();
+
+	std::lock_guard<std::mutex> lock(JitRuntimeMutex);
 #ifdef _WIN64
 	for (auto p : JitFrames)
 	{
@@ -754,10 +763,12 @@ void JitRelease()
 		asmjit::OSUtils::releaseVirtualMemory(p, 1024 * 1024);
 	}
 	JitDebugInfo.Clear();
+	JitDebugInfoSorted.Clear();
 	JitFrames.Clear();
 	JitBlocks.Clear();
 	JitBlockPos = 0;
 	JitBlockSize = 0;
+	JitReleaseCallCaches();
 }
 
 static int CaptureStackTrace(int max_frames, void **out_frames)
@@ -958,6 +969,7 @@ int JITPCToLine(uint8_t *pc, const JitFuncInfo *info)
 
 FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
 {
+	std::unique_lock<std::mutex> lock(JitRuntimeMutex);
 	for (unsigned int i = 0; i < JitDebugInfo.Size(); i++)
 	{
 		const auto &info = JitDebugInfo[i];
@@ -975,6 +987,7 @@ FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
 			return s;
 		}
 	}
+	lock.unlock();
 
 	return nativeSymbols ? nativeSymbols->GetName(pc) : FString();
 }
@@ -1007,3 +1020,55 @@ FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int max
 	}
 	return s;
 }
+
+static const JitFuncInfo *FindJitFuncInfo(void *pc)
+{
+	if (JitDebugInfoSorted.Size() != JitDebugInfo.Size())
+	{
+		JitDebugInfoSorted.Resize(JitDebugInfo.Size());
+		for (unsigned int i = 0; i < JitDebugInfo.Size(); i++)
+			JitDebugInfoSorted[i] = i;
+		std::sort(JitDebugInfoSorted.begin(), JitDebugInfoSorted.end(), [](unsigned int a, unsigned int b) { return JitDebugInfo[a].start < JitDebugInfo[b].start; });
+	}
+
+	// Find the last function starting at or before pc.
+	unsigned int first = 0, count = JitDebugInfoSorted.Size();
+	while (count > 0)
+	{
+		unsigned int step = count / 2;
+		if (JitDebugInfo[JitDebugInfoSorted[first + step]].start <= pc)
+		{
+			first += step + 1;
+			count -= step + 1;
+		}
+		else
+		{
+			count = step;
+		}
+	}
+	if (first == 0)
+		return nullptr;
+
+	const JitFuncInfo &info = JitDebugInfo[JitDebugInfoSorted[first - 1]];
+	return pc < info.end ? &info : nullptr;
+}
+
+int JitCaptureScriptFrames(VMScriptFunction **funcs, int *lines, int maxFrames)
+{
+	void *frames[64];
+	int numframes = CaptureStackTrace(64, frames);
+
+	std::lock_guard<std::mutex> lock(JitRuntimeMutex);
+	int count = 0;
+	for (int i = 0; i < numframes && count < maxFrames; i++)
+	{
+		const JitFuncInfo *info = FindJitFuncInfo(frames[i]);
+		if (info)
+		{
+			funcs[count] = info->func;
+			lines[count] = JITPCToLine((uint8_t *)frames[i], info);
+			count++;
+		}
+	}
+	return count;
+}
@@ -32,6 +32,39 @@ struct JitLineInfo
 	asmjit::Label Label;
 };
 
+class JitCompiler;
+
+// The VM registers of one register type. asmjit can only handle a limited number of virtual
+// registers, so for big functions only the lower registers are kept in asmjit registers.
+// The others live in their slot in the VM frame and get loaded into a temporary by the first
+// opcode accessing them. JitCompiler::StoreSpilledRegisters writes them back after the opcode.
+template<typename RegType>
+class JitRegisters
+{
+public:
+	void Init(JitCompiler *compiler, int regtype, int count, int numcached)
+	{
+		Compiler = compiler;
+		RegisterType = regtype;
+		NumCached = numcached;
+		Regs.Resize(count);
+		Loaded.Resize(count);
+		for (auto &loaded : Loaded) loaded = false;
+	}
+
+	RegType &operator[](size_t index);
+	unsigned int Size() const { return Regs.Size(); }
+	bool IsSpilled(int index) const { return index >= NumCached; }
+
+	TArray<RegType> Regs;
+	TArray<bool> Loaded;
+
+private:
+	JitCompiler *Compiler = nullptr;
+	int RegisterType = 0;
+	int NumCached = 0;
+};
+
 class JitCompiler
 {
 public:
@@ -53,6 +86,7 @@ private:
 	void Setup();
 	void CreateRegisters();
 	void IncrementVMCalls();
+	void EmitProfilerSample();
 	void SetupFrame();
 	void SetupSimpleFrame();
 	void SetupFullVMFrame();
@@ -62,6 +96,7 @@ private:
 
 	void EmitNativeCall(VMNativeFunction *target);
 	void EmitVMCall(asmjit::X86Gp ptr, VMFunction *target);
+	void EmitVMCallBody(asmjit::X86Gp ptr, VMFunction *target);
 	void EmitVtbl(const VMOP *op);
 
 	int StoreCallParams();
@@ -198,6 +233,9 @@ private:
 	size_t tmpPosInt32, tmpPosInt64, tmpPosIntPtr, tmpPosXmmSd, tmpPosXmmSs, tmpPosXmmPd, resultPosInt32, resultPosIntPtr, resultPosXmmSd;
 	std::vector<asmjit::X86Gp> regTmpInt32, regTmpInt64, regTmpIntPtr, regResultInt32, regResultIntPtr;
 	std::vector<asmjit::X86Xmm> regTmpXmmSd, regTmpXmmSs, regTmpXmmPd, regResultXmmSd;
+	size_t spillPosInt32, spillPosIntPtr, spillPosXmmSd;
+	std::vector<asmjit::X86Gp> regSpillInt32, regSpillIntPtr;
+	std::vector<asmjit::X86Xmm> regSpillXmmSd;
 
 	void ResetTemp()
 	{
@@ -210,6 +248,9 @@ private:
 		resultPosInt32 = 0;
 		resultPosIntPtr = 0;
 		resultPosXmmSd = 0;
+		spillPosInt32 = 0;
+		spillPosIntPtr = 0;
+		spillPosXmmSd = 0;
 	}
 
 	template<typename T, typename NewFunc>
@@ -232,6 +273,10 @@ private:
 
 	asmjit::X86Gp newResultInt32() { return newTempRegister(regResultInt32, resultPosInt32, "resultDword", [&](const char *name) { return cc.newInt32(name); }); }
 	asmjit::X86Gp newResultIntPtr() { return newTempRegister(regResultIntPtr, resultPosIntPtr, "resultPtr", [&](const char *name) { return cc.newIntPtr(name); }); }
+	asmjit::X86Gp newSpillInt32() { return newTempRegister(regSpillInt32, spillPosInt32, "spillDword", [&](const char *name) { return cc.newInt32(name); }); }
+	asmjit::X86Gp newSpillIntPtr() { return newTempRegister(regSpillIntPtr, spillPosIntPtr, "spillPtr", [&](const char *name) { return cc.newIntPtr(name); }); }
+	asmjit::X86Xmm newSpillXmmSd() { return newTempRegister(regSpillXmmSd, spillPosXmmSd, "spillXmmSd", [&](const char *name) { return cc.newXmmSd(name); }); }
+
 	asmjit::X86Xmm newResultXmmSd() { return newTempRegister(regResultXmmSd, resultPosXmmSd, "resultXmmSd", [&](const char *name) { return cc.newXmmSd(name); }); }
 
 	void EmitReadBarrier();
@@ -286,10 +331,19 @@ private:
 	const FString *konsts;
 	const FVoidObj *konsta;
 
-	TArray<asmjit::X86Gp> regD;
-	TArray<asmjit::X86Xmm> regF;
-	TArray<asmjit::X86Gp> regA;
-	TArray<asmjit::X86Gp> regS;
+	JitRegisters<asmjit::X86Gp> regD;
+	JitRegisters<asmjit::X86Xmm> regF;
+	JitRegisters<asmjit::X86Gp> regA;
+	JitRegisters<asmjit::X86Gp> regS;
+
+	// Register spilling for functions with more VM registers than asmjit can handle
+	void LoadSpilledRegister(int regtype, int index);
+	void StoreSpilledRegisters();
+	bool spillRegisters = false;
+	asmjit::CBNode *spillCursor = nullptr;
+	TArray<std::pair<int, int>> loadedSpills;
+
+	template<typename RegType> friend class JitRegisters;
 
 	struct OpcodeLabel
 	{
@@ -328,6 +382,14 @@ private:
 	VM_UBYTE op;
 };
 
+template<typename RegType>
+RegType &JitRegisters<RegType>::operator[](size_t index)
+{
+	if ((int)index >= NumCached && !Loaded[index])
+		Compiler->LoadSpilledRegister(RegisterType, (int)index);
+	return Regs[index];
+}
+
 class AsmJitException : public std::exception
 {
 public:
@@ -354,4 +416,7 @@ public:
 };
 
 void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler);
+JitFuncPtr JitCompileBackground(VMScriptFunction *sfunc, FString &error);
+void OutputJitLog(const char *log);
+void JitReleaseCallCaches();
 asmjit::CodeInfo GetHostCodeInfo();
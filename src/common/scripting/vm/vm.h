@@ -57,6 +57,7 @@ extern FMemArena ClassDataAllocator;
 #define MAX_TRY_DEPTH	8	// Maximum number of nested TRYs in a single function
 
 void JitRelease();
+void VMProfilerReset();
 
 extern void (*VM_CastSpriteIDToString)(FString* a, unsigned int b);
 
@@ -474,13 +475,14 @@ public:
 	void operator delete[](void *block) {}
 	static void DeleteAll()
 	{
+		// release any JIT data first so that no background compile can still be looking at the functions.
+		VMProfilerReset();
+		JitRelease();
 		for (auto f : AllFunctions)
 		{
 			f->~VMFunction();
 		}
 		AllFunctions.Clear();
-		// also release any JIT data
-		JitRelease();
 	}
 	static void CreateRegUseInfo()
 	{
@@ -728,6 +728,10 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 		}
 		NEXTOP;
 	OP(JMP):
+		if (JMPOFS(pc) < 0 && VMProfilerSampleRequested.load(std::memory_order_relaxed))
+		{
+			VMProfilerSample(f, pc);
+		}
 		pc += JMPOFS(pc);
 		NEXTOP;
 	OP(IJMP):
@@ -884,6 +888,11 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 
 			b = B;
 			FillReturns(reg, f, returns, pc+1, C);
+			f->PC = pc;
+			if (VMProfilerSampleRequested.load(std::memory_order_relaxed))
+			{
+				VMProfilerSample(f, pc);
+			}
 			if (call->VarFlags & VARF_Native)
 			{
 				try
@@ -33,6 +33,7 @@
 */
 
 #include <new>
+#include <thread>
 #include "dobject.h"
 #include "v_text.h"
 #include "stats.h"
@@ -59,9 +60,30 @@ CUSTOM_CVAR(Bool, vm_jit_aot, true, CVAR_NOINITCALL)
 	Printf("You must restart " GAMENAME " for this change to take effect.\n");
 	Printf("This cvar is currently not saved. You must specify it on the command line.");
 }
+// Tiered mode: functions start in the VM and only get compiled in the background once they are called often enough.
+CUSTOM_CVAR(Bool, vm_jit_tiered, false, CVAR_NOINITCALL)
+{
+	Printf("You must restart " GAMENAME " for this change to take effect.\n");
+	Printf("This cvar is currently not saved. You must specify it on the command line.");
+}
+CUSTOM_CVAR(Int, vm_jit_tiered_threshold, 100, 0)
+{
+	if (self < 1) self = 1;
+}
+// Number of threads used for vm_jit_aot. 0 uses all cores, 1 compiles everything on the main thread.
+CUSTOM_CVAR(Int, vm_jit_aot_threads, 0, CVAR_NOINITCALL)
+{
+	Printf("You must restart " GAMENAME " for this change to take effect.\n");
+	Printf("This cvar is currently not saved. You must specify it on the command line.");
+}
+// Inline caches at virtual call sites. Only affects functions compiled after the change.
+CVAR(Bool, vm_jit_callcache, true, CVAR_NOINITCALL)
+// Counts hits and misses of the inline caches for 'stat jit'. Slows down the calls a bit.
+CVAR(Bool, vm_jit_callstats, false, CVAR_NOINITCALL)
 #else
 CVAR(Bool, vm_jit, false, CVAR_NOINITCALL|CVAR_NOSET)
 CVAR(Bool, vm_jit_aot, false, CVAR_NOINITCALL|CVAR_NOSET)
+CVAR(Bool, vm_jit_tiered, false, CVAR_NOINITCALL|CVAR_NOSET)
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int maxFrames) { return FString(); }
 void JitRelease() {}
 #endif
@@ -276,18 +298,9 @@ int VMScriptFunction::PCToLine(const VMOP *pc)
 
 static bool CanJit(VMScriptFunction *func)
 {
-	// Asmjit has a 256 register limit. Stay safely away from it as the jit compiler uses a few for temporaries as well.
-	// Any function exceeding the limit will use the VM - a fair punishment to someone for writing a function so bloated ;)
-
-	if(func->blockJit) return false;
-
-	int maxregs = 200;
-	if (func->NumRegA + func->NumRegD + func->NumRegF + func->NumRegS < maxregs)
-		return true;
-
-	Printf(TEXTCOLOR_ORANGE "%s is using too many registers (%d of max %d)! Function will not use native code.\n", func->PrintableName, func->NumRegA + func->NumRegD + func->NumRegF + func->NumRegS, maxregs);
-
-	return false;
+	// Functions with more registers than asmjit can handle are still compiled.
+	// The JIT keeps the excess registers in the VM frame, see JitCompiler::CreateRegisters.
+	return !func->blockJit;
 }
 
 void VMScriptFunction::JitCompile()
@@ -297,16 +310,83 @@ void VMScriptFunction::JitCompile()
 	#ifdef HAVE_VM_JIT
 		if (vm_jit && CanJit(this))
 		{
+			if (vm_jit_tiered)
+			{
+				// Stay in the VM for now. TieredScriptCall queues the function for the background compiler once it gets hot.
+				ScriptCall = &VMScriptFunction::TieredScriptCall;
+				JitState = JitState_Interpreted;
+				JitTierStats.Interpreted++;
+				return;
+			}
+
 			ScriptCall = ::JitCompile(this);
-			if (!ScriptCall)
-				ScriptCall = VMExec;
+			if (ScriptCall)
+			{
+				JitState = JitState_Compiled;
+				JitTierStats.Compiled++;
+				return;
+			}
 		}
-		else
+		JitState = JitState_Failed;
+		JitTierStats.Failed++;
 	#endif // HAVE_VM_JIT
+		ScriptCall = VMExec;
+	}
+}
+
+void VMScriptFunction::JitCompileAll(const TArray<VMScriptFunction *> &functions)
+{
+#ifdef HAVE_VM_JIT
+	int numThreads = vm_jit_aot_threads > 0 ? *vm_jit_aot_threads : (int)std::thread::hardware_concurrency();
+	if (!vm_jit || numThreads <= 1)
+#endif
+	{
+		for (auto func : functions)
+		{
+			func->JitCompile();
+		}
+		return;
+	}
+
+#ifdef HAVE_VM_JIT
+	TArray<VMScriptFunction *> compile;
+	for (auto func : functions)
+	{
+		if (func->VarFlags & VARF_Abstract)
+			continue;
+
+		if (CanJit(func))
 		{
-			ScriptCall = VMExec;
+			compile.Push(func);
+		}
+		else
+		{
+			func->ScriptCall = VMExec;
+			func->JitState = JitState_Failed;
+			JitTierStats.Failed++;
 		}
 	}
+
+	TArray<JitFuncPtr> code;
+	JitCompileParallel(compile, code, numThreads);
+
+	for (unsigned i = 0; i < compile.Size(); i++)
+	{
+		auto func = compile[i];
+		if (code[i])
+		{
+			func->ScriptCall = code[i];
+			func->JitState = JitState_Compiled;
+			JitTierStats.Compiled++;
+		}
+		else
+		{
+			func->ScriptCall = VMExec;
+			func->JitState = JitState_Failed;
+			JitTierStats.Failed++;
+		}
+	}
+#endif
 }
 
 int VMScriptFunction::FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
@@ -324,6 +404,30 @@ int VMScriptFunction::FirstScriptCall(VMFunction *func, VMValue *params, int num
 	return func->ScriptCall(func, params, numparams, ret, numret);
 }
 
+int VMScriptFunction::TieredScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
+{
+#ifdef HAVE_VM_JIT
+	auto sfunc = static_cast<VMScriptFunction*>(func);
+	if (sfunc->JitState == JitState_Interpreted && ++sfunc->CallCount >= (unsigned)*vm_jit_tiered_threshold)
+	{
+		sfunc->JitState = JitState_Queued;
+		JitTierStats.Interpreted--;
+		JitTierStats.Queued++;
+		JitQueueCompile(sfunc);
+	}
+
+	// Hot functions come through here often enough to pick up finished code quickly.
+	// Nothing can be installed for a function that has not been queued.
+	if (sfunc->JitState == JitState_Queued)
+	{
+		JitInstallCompiled();
+		if (func->ScriptCall != &VMScriptFunction::TieredScriptCall)
+			return func->ScriptCall(func, params, numparams, ret, numret);
+	}
+#endif
+	return VMExec(func, params, numparams, ret, numret);
+}
+
 int VMNativeFunction::NativeScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *returns, int numret)
 {
 	try
@@ -422,6 +526,7 @@ VMFrame *VMFrameStack::AllocFrame(VMScriptFunction *func)
 	frame->NumRegA = func->NumRegA;
 	frame->MaxParam = func->MaxParam;
 	frame->Func = func;
+	frame->PC = nullptr;
 	frame->InitRegS();
 	if (func->SpecialInits.Size())
 	{
@@ -839,6 +944,29 @@ ADD_STAT(VM)
 	return FStringf("VM time in last 10 tics: %f ms, %d calls, peak = %f ms", added, addedc, peak);
 }
 
+#ifdef HAVE_VM_JIT
+ADD_STAT(jit)
+{
+	JitInstallCompiled();
+	int sites;
+	uint64_t hits, misses;
+	JitGetCallCacheStats(sites, hits, misses);
+	FString out;
+	out.Format("JIT functions: %d interpreted, %d queued, %d compiled, %d VM only\n",
+		JitTierStats.Interpreted, JitTierStats.Queued, JitTierStats.Compiled, JitTierStats.Failed);
+	if (vm_jit_callstats)
+	{
+		out.AppendFormat("Virtual call caches: %d sites, %llu hits, %llu misses (%.1f%% hit rate)",
+			sites, (unsigned long long)hits, (unsigned long long)misses, hits + misses > 0 ? hits * 100. / (hits + misses) : 0.);
+	}
+	else
+	{
+		out.AppendFormat("Virtual call caches: %d sites (set vm_jit_callstats to count hits)", sites);
+	}
+	return out;
+}
+#endif
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -2,6 +2,7 @@
 
 #include "vm.h"
 #include <csetjmp>
+#include <atomic>
 
 class VMScriptFunction;
 
@@ -255,6 +256,7 @@ struct VMFrame
 	VM_UBYTE NumRegA;
 	VM_UHALF MaxParam;
 	VM_UHALF NumParam;		// current number of parameters
+	const VMOP *PC;			// last call made from this frame by the interpreter. Used by the profiler.
 
 	static int FrameSize(int numregd, int numregf, int numregs, int numrega, int numparam, int numextra)
 	{
@@ -348,6 +350,12 @@ struct FStatementInfo
 	uint16_t LineNumber;
 };
 
+struct FVirtualCallInfo
+{
+	unsigned InstructionIndex;	// of the OP_VTBL
+	VMFunction *Declared;		// the function in the class the call was compiled against
+};
+
 class VMFrameStack
 {
 public:
@@ -473,9 +481,22 @@ public:
 	VM_UHALF MaxParam;		// Maximum number of parameters this function has on the stack at once
 	VM_UBYTE NumArgs;		// Number of arguments this function takes
 	TArray<FTypeAndOffset> SpecialInits;	// list of all contents on the extra stack which require construction and destruction
+	TArray<FVirtualCallInfo> VirtualCalls;	// used by the JIT to guess the target of virtual calls
 
 	bool blockJit = false; // function triggers Jit bugs, block compilation until bugs are fixed
 
+	// Tiered JIT bookkeeping. Only ever touched by the game thread.
+	enum EJitState : uint8_t
+	{
+		JitState_None,			// not called yet
+		JitState_Interpreted,	// running in the VM and counting calls
+		JitState_Queued,		// handed to the background compiler
+		JitState_Compiled,		// ScriptCall points to native code
+		JitState_Failed,		// could not be compiled, stays in the VM
+	};
+	EJitState JitState = JitState_None;
+	unsigned CallCount = 0;
+
 	void InitExtra(void *addr);
 	void DestroyExtra(void *addr);
 	int AllocExtraStack(PType *type);
@@ -483,6 +504,14 @@ public:
 
 private:
 	static int FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
+	static int TieredScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
 	void JitCompile();
+	static void JitCompileAll(const TArray<VMScriptFunction *> &functions);
 	friend class FFunctionBuildList;
 };
+
+// Sampling profiler, see vmprofiler.cpp. The sampler thread sets VMProfilerSampleRequested
+// and the next script function entry, call or loop iteration on the game thread takes the sample.
+extern std::atomic<int> VMProfilerSampleRequested;
+void VMProfilerSample(VMFrame *frame, const VMOP *pc);
+void VMProfilerSampleJit(VMScriptFunction *func);
@@ -0,0 +1,392 @@
+/*
+** vmprofiler.cpp
+** Sampling profiler for script code
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** A thread wakes up at a fixed interval and raises a flag. The game thread
+** checks the flag at function entry and backward jumps in JIT code and at
+** calls and backward jumps in the interpreter, and records the script call
+** stack when it is set.
+** Nothing else is done while the profiler runs, so the overhead is one memory
+** read per check plus the stack walk for every sample.
+**
+** Interpreted frames get their lines from VMFrame::PC, JIT frames from the
+** native stack and the JIT's line tables. A sample taken in JIT code only
+** contains JIT frames and a sample taken in the interpreter only contains
+** frames on the VM stack.
+**
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "dobject.h"
+#include "vmintern.h"
+#include "types.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "i_time.h"
+#ifdef HAVE_VM_JIT
+#include "jit.h"
+#endif
+
+std::atomic<int> VMProfilerSampleRequested;
+
+// JIT code reads the flag as a plain int.
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "std::atomic<int> must have the same layout as int");
+
+struct FProfileFrame
+{
+	VMScriptFunction *Func;
+	int Line;
+};
+
+struct FProfileSample
+{
+	uint64_t Time;			// microseconds since the profiler was started
+	unsigned FirstFrame;	// outermost frame first
+	unsigned NumFrames;
+};
+
+class FVMProfiler
+{
+public:
+	~FVMProfiler()
+	{
+		StopSampler();
+	}
+
+	bool IsRunning() const
+	{
+		return Sampler.joinable();
+	}
+
+	void Start(int interval)
+	{
+		Samples.Clear();
+		Frames.Clear();
+		StartTime = I_nsTime();
+		Interval = interval;
+		StopRequested = false;
+		Sampler = std::thread([this]() { SamplerMain(); });
+	}
+
+	void StopSampler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			StopRequested = true;
+		}
+		WakeUp.notify_all();
+		if (Sampler.joinable())
+			Sampler.join();
+		VMProfilerSampleRequested.store(0, std::memory_order_relaxed);
+	}
+
+	void Clear()
+	{
+		Samples.Clear();
+		Frames.Clear();
+	}
+
+	// Takes the frames innermost first and stores them outermost first.
+	void AddSample(VMScriptFunction **funcs, int *lines, int count)
+	{
+		if (count == 0)
+			return;
+
+		FProfileSample sample;
+		sample.Time = (I_nsTime() - StartTime) / 1000;
+		sample.FirstFrame = Frames.Size();
+		sample.NumFrames = count;
+		for (int i = count - 1; i >= 0; i--)
+		{
+			Frames.Push({ funcs[i], lines[i] });
+		}
+		Samples.Push(sample);
+	}
+
+	bool WriteCollapsed(const char *filename);
+	bool WriteChromeTrace(const char *filename);
+
+	unsigned NumSamples() const
+	{
+		return Samples.Size();
+	}
+
+private:
+	void SamplerMain()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (!WakeUp.wait_for(lock, std::chrono::microseconds(Interval), [this]() { return StopRequested; }))
+		{
+			VMProfilerSampleRequested.store(1, std::memory_order_relaxed);
+		}
+	}
+
+	FString GetFrameName(const FProfileFrame &frame)
+	{
+		if (frame.Line >= 0)
+			return FStringf("%s (%s:%d)", frame.Func->PrintableName, frame.Func->SourceFileName.GetChars(), frame.Line);
+		else
+			return FStringf("%s (%s)", frame.Func->PrintableName, frame.Func->SourceFileName.GetChars());
+	}
+
+	std::thread Sampler;
+	std::mutex Mutex;
+	std::condition_variable WakeUp;
+	bool StopRequested = false;
+	int Interval = 1000;
+
+	uint64_t StartTime = 0;
+	TArray<FProfileSample> Samples;
+	TArray<FProfileFrame> Frames;
+};
+
+static FVMProfiler Profiler;
+
+//==========================================================================
+//
+// Samples
+//
+//==========================================================================
+
+enum
+{
+	MAX_PROFILE_FRAMES = 64
+};
+
+void VMProfilerSample(VMFrame *frame, const VMOP *pc)
+{
+	if (!VMProfilerSampleRequested.exchange(0, std::memory_order_relaxed))
+		return;
+
+	VMScriptFunction *funcs[MAX_PROFILE_FRAMES];
+	int lines[MAX_PROFILE_FRAMES];
+	int count = 0;
+	for (; frame != nullptr && count < MAX_PROFILE_FRAMES; frame = frame->ParentFrame)
+	{
+		if (frame->Func == nullptr || (frame->Func->VarFlags & VARF_Native))
+			continue;
+
+		auto sfunc = static_cast<VMScriptFunction *>(frame->Func);
+		const VMOP *framepc = count == 0 ? pc : frame->PC;
+		funcs[count] = sfunc;
+		lines[count] = framepc ? sfunc->PCToLine(framepc) : -1;
+		count++;
+	}
+	Profiler.AddSample(funcs, lines, count);
+}
+
+void VMProfilerSampleJit(VMScriptFunction *func)
+{
+	if (!VMProfilerSampleRequested.exchange(0, std::memory_order_relaxed))
+		return;
+
+	VMScriptFunction *funcs[MAX_PROFILE_FRAMES];
+	int lines[MAX_PROFILE_FRAMES];
+	int count = 0;
+#ifdef HAVE_VM_JIT
+	count = JitCaptureScriptFrames(funcs, lines, MAX_PROFILE_FRAMES);
+#endif
+	if (count == 0)
+	{
+		// No stack walking available on this platform. At least record who was called.
+		funcs[0] = func;
+		lines[0] = -1;
+		count = 1;
+	}
+	Profiler.AddSample(funcs, lines, count);
+}
+
+void VMProfilerReset()
+{
+	if (Profiler.IsRunning())
+	{
+		Printf("Script profiler stopped. Samples discarded.\n");
+	}
+	Profiler.StopSampler();
+	Profiler.Clear();
+}
+
+//==========================================================================
+//
+// Output
+//
+//==========================================================================
+
+// One line per distinct stack, frames separated by semicolons, followed by
+// the number of samples. This is the input format of flamegraph.pl and speedscope.
+bool FVMProfiler::WriteCollapsed(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == nullptr)
+		return false;
+
+	TMap<FString, unsigned> stacks;
+	TArray<FString> order;
+	for (auto &sample : Samples)
+	{
+		FString stack;
+		for (unsigned i = 0; i < sample.NumFrames; i++)
+		{
+			if (i > 0) stack << ';';
+			stack << GetFrameName(Frames[sample.FirstFrame + i]);
+		}
+		auto count = stacks.CheckKey(stack);
+		if (count == nullptr)
+		{
+			stacks.Insert(stack, 1);
+			order.Push(stack);
+		}
+		else
+		{
+			(*count)++;
+		}
+	}
+
+	for (auto &stack : order)
+	{
+		fprintf(f, "%s %u\n", stack.GetChars(), *stacks.CheckKey(stack));
+	}
+	fclose(f);
+	return true;
+}
+
+static FString JsonEscape(const FString &str)
+{
+	FString out;
+	for (unsigned i = 0; i < str.Len(); i++)
+	{
+		char c = str[i];
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if ((unsigned char)c < 32) out.AppendFormat("\\u%04x", c);
+		else out << c;
+	}
+	return out;
+}
+
+// Chrome trace event format with a stack frame tree and one sample event per sample.
+// It can be opened in chrome://tracing, Perfetto and speedscope.
+bool FVMProfiler::WriteChromeTrace(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == nullptr)
+		return false;
+
+	TMap<FString, unsigned> nodeIds;
+	TArray<unsigned> sampleNodes;
+
+	fprintf(f, "{\"traceEvents\":[],\n\"stackFrames\":{");
+	for (auto &sample : Samples)
+	{
+		unsigned parent = 0;
+		for (unsigned i = 0; i < sample.NumFrames; i++)
+		{
+			FString name = GetFrameName(Frames[sample.FirstFrame + i]);
+			FString key = FStringf("%u;%s", parent, name.GetChars());
+			auto id = nodeIds.CheckKey(key);
+			if (id == nullptr)
+			{
+				unsigned newid = nodeIds.CountUsed() + 1;
+				nodeIds.Insert(key, newid);
+				fprintf(f, "%s\n\"%u\":{\"category\":\"zscript\",\"name\":\"%s\"", newid > 1 ? "," : "", newid, JsonEscape(name).GetChars());
+				if (parent != 0) fprintf(f, ",\"parent\":\"%u\"", parent);
+				fprintf(f, "}");
+				parent = newid;
+			}
+			else
+			{
+				parent = *id;
+			}
+		}
+		sampleNodes.Push(parent);
+	}
+
+	fprintf(f, "},\n\"samples\":[");
+	for (unsigned i = 0; i < Samples.Size(); i++)
+	{
+		fprintf(f, "%s\n{\"cpu\":0,\"tid\":1,\"ts\":%llu,\"name\":\"sample\",\"weight\":1,\"sf\":\"%u\"}",
+			i > 0 ? "," : "", (unsigned long long)Samples[i].Time, sampleNodes[i]);
+	}
+	fprintf(f, "]}\n");
+	fclose(f);
+	return true;
+}
+
+//==========================================================================
+//
+// Console commands
+//
+//==========================================================================
+
+CCMD(startvmprofile)
+{
+	if (Profiler.IsRunning())
+	{
+		Printf("Script profiler is already running.\n");
+		return;
+	}
+
+	int interval = argv.argc() > 1 ? atoi(argv[1]) : 1000;
+	if (interval < 100)
+	{
+		Printf("Usage: startvmprofile [interval in microseconds, at least 100]\n");
+		return;
+	}
+
+	Profiler.Start(interval);
+	Printf("Script profiler started, sampling every %d microseconds.\n", interval);
+}
+
+CCMD(stopvmprofile)
+{
+	if (!Profiler.IsRunning())
+	{
+		Printf("Script profiler is not running.\n");
+		return;
+	}
+	Profiler.StopSampler();
+
+	FString basename = argv.argc() > 1 ? argv[1] : "vmprofile";
+	FString collapsed = basename + ".folded";
+	FString trace = basename + ".json";
+
+	Printf("Script profiler stopped, %u samples taken.\n", Profiler.NumSamples());
+	if (Profiler.WriteCollapsed(collapsed.GetChars()))
+		Printf("Wrote %s\n", collapsed.GetChars());
+	else
+		Printf("Unable to write %s\n", collapsed.GetChars());
+
+	if (Profiler.WriteChromeTrace(trace.GetChars()))
+		Printf("Wrote %s\n", trace.GetChars());
+	else
+		Printf("Unable to write %s\n", trace.GetChars());
+
+	Profiler.Clear();
+}
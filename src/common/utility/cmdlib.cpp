@@ -47,6 +47,10 @@
 #ifndef _WIN32
 #include <pwd.h>
 #include <unistd.h>
+#else
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 #endif
 
 /*
@@ -603,6 +607,18 @@ void RemoveFile(const char* file)
 #endif
 }
 
+// Replaces the destination if it exists, so that it is either the old or the new file but never missing.
+bool RenameFile(const char* from, const char* to)
+{
+#ifndef _WIN32
+	return rename(from, to) == 0;
+#else
+	auto wfrom = WideString(from);
+	auto wto = WideString(to);
+	return MoveFileExW(wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#endif
+}
+
 int RemoveDir(const char* file)
 {
 #ifndef _WIN32
@@ -3035,8 +3035,6 @@ static void Doom_CastSpriteIDToString(FString* a, unsigned int b)
 }
 
 
-extern DThinker* NextToThink;
-
 static void GC_MarkGameRoots()
 {
 	GC::Mark(staticEventManager.FirstEventHandler);
@@ -3050,9 +3048,6 @@ static void GC_MarkGameRoots()
 		if (playeringame[i])
 			players[i].PropagateMark();
 	}
-
-	// NextToThink must not be freed while thinkers are ticking.
-	GC::Mark(NextToThink);
 }
 
 static void System_ToggleFullConsole()
@@ -3992,6 +3987,8 @@ int GameMain()
 
 void D_Cleanup()
 {
+	G_FinishPendingSave(true);
+
 	if (demorecording)
 	{
 		G_CheckDemoStatus();
@@ -268,8 +268,93 @@ void DNetworkBuffer::Serialize(FSerializer& arc)
 	}
 }
 
+// ===========================================
+//
+//  Subscriber lists
+//
+// ===========================================
+
+static bool isEmpty(VMFunction *func);
+
+static const char *const SubscribedEventNames[NUM_EVENT_SUBSCRIPTIONS] =
+{
+	"WorldThingSpawned",
+	"WorldThingDied",
+	"WorldThingRevived",
+	"WorldThingDamaged",
+	"WorldThingDestroyed",
+	"WorldThingGround",
+	"WorldHitscanFired",
+	"WorldRailgunFired",
+	"WorldLinePreActivated",
+	"WorldLineActivated",
+	"WorldLightning",
+	"WorldTick",
+	"UiTick",
+	"PostUiTick",
+	"RenderFrame",
+	"RenderOverlay",
+	"RenderUnderlay",
+};
+
+void EventManager::UpdateSubscribers()
+{
+	static unsigned VIndex[NUM_EVENT_SUBSCRIPTIONS];
+	static bool inited;
+
+	if (!inited)
+	{
+		for (int i = 0; i < NUM_EVENT_SUBSCRIPTIONS; i++)
+		{
+			VIndex[i] = GetVirtualIndex(RUNTIME_CLASS(DStaticEventHandler), SubscribedEventNames[i]);
+			assert(VIndex[i] != ~0u);
+		}
+		inited = true;
+	}
+
+	for (auto &list : Subscribers) list.Clear();
+	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
+	{
+		auto clss = handler->GetClass();
+		for (int i = 0; i < NUM_EVENT_SUBSCRIPTIONS; i++)
+		{
+			// These are exactly the handlers that would not return early in the event's own override check.
+			VMFunction *func = clss->Virtuals.Size() > VIndex[i] ? clss->Virtuals[VIndex[i]] : nullptr;
+			if (func != nullptr && !isEmpty(func)) Subscribers[i].Push(handler);
+		}
+	}
+	SubscriberGeneration = HandlerGeneration;
+}
+
+// Calls the handlers that override an event in list order. If the handler list changes
+// during one of the calls, the rest is done by walking the list from that handler on,
+// exactly like it was done before there were subscriber lists.
+template<class Func> void EventManager::CallSubscribers(EEventSubscription event, bool backwards, Func call)
+{
+	if (SubscriberGeneration != HandlerGeneration) UpdateSubscribers();
+
+	unsigned generation = HandlerGeneration;
+	auto &list = Subscribers[event];
+	unsigned count = list.Size();
+	for (unsigned i = 0; i < count; i++)
+	{
+		DStaticEventHandler* handler = list[backwards ? count - 1 - i : i];
+		call(handler);
+		if (HandlerGeneration != generation)
+		{
+			for (handler = backwards ? handler->prev : handler->next; handler; handler = backwards ? handler->prev : handler->next)
+			{
+				call(handler);
+			}
+			return;
+		}
+	}
+}
+
 void EventManager::CallOnRegister()
 {
+	// The list was just read from a savegame.
+	HandlerGeneration++;
 	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
 	{
 		handler->OnRegister();
@@ -342,6 +427,7 @@ bool EventManager::RegisterHandler(DStaticEventHandler* handler)
 		handler->ObjectFlags |= OF_Transient;
 	}
 
+	HandlerGeneration++;
 	return true;
 }
 
@@ -375,6 +461,7 @@ bool EventManager::UnregisterHandler(DStaticEventHandler* handler)
 		LastEventHandler = handler->prev;
 		GC::WriteBarrier(handler->prev);
 	}
+	HandlerGeneration++;
 	if (handler->IsStatic())
 	{
 		handler->ObjectFlags &= ~OF_Transient;
@@ -644,13 +731,13 @@ void EventManager::Shutdown()
 		handler->Destroy();
 	}
 	FirstEventHandler = LastEventHandler = nullptr;
+	HandlerGeneration++;
 }
 
 #define DEFINE_EVENT_LOOPER(name, play) void EventManager::name() \
 { \
 	if (ShouldCallStatic(play)) staticEventManager.name(); \
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next) \
-		handler->name(); \
+	CallSubscribers(ESUB_##name, false, [&](DStaticEventHandler* handler) { handler->name(); }); \
 }
 
 void EventManager::OnEngineInitialize()
@@ -696,8 +783,7 @@ void EventManager::WorldThingSpawned(AActor* actor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingSpawned(actor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingSpawned(actor);
+	CallSubscribers(ESUB_WorldThingSpawned, false, [&](DStaticEventHandler* handler) { handler->WorldThingSpawned(actor); });
 }
 
 void EventManager::WorldThingDied(AActor* actor, AActor* inflictor)
@@ -708,8 +794,7 @@ void EventManager::WorldThingDied(AActor* actor, AActor* inflictor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDied(actor, inflictor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingDied(actor, inflictor);
+	CallSubscribers(ESUB_WorldThingDied, false, [&](DStaticEventHandler* handler) { handler->WorldThingDied(actor, inflictor); });
 }
 
 bool EventManager::WorldHitscanPreFired(AActor* actor, DAngle angle, double distance, DAngle pitch, int damage, FName damageType, PClassActor *pufftype, int flags, double sz, double offsetforward, double offsetside)
@@ -759,8 +844,7 @@ void EventManager::WorldHitscanFired(AActor* actor, const DVector3& AttackPos, c
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldHitscanFired(actor, AttackPos, DamagePosition, Inflictor, flags);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldHitscanFired(actor, AttackPos, DamagePosition, Inflictor, flags);
+	CallSubscribers(ESUB_WorldHitscanFired, false, [&](DStaticEventHandler* handler) { handler->WorldHitscanFired(actor, AttackPos, DamagePosition, Inflictor, flags); });
 }
 
 void EventManager::WorldRailgunFired(AActor* actor, const DVector3& AttackPos, const DVector3& DamagePosition, AActor* Inflictor, int flags)
@@ -771,8 +855,7 @@ void EventManager::WorldRailgunFired(AActor* actor, const DVector3& AttackPos, c
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldRailgunFired(actor, AttackPos, DamagePosition, Inflictor, flags);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldRailgunFired(actor, AttackPos, DamagePosition, Inflictor, flags);
+	CallSubscribers(ESUB_WorldRailgunFired, false, [&](DStaticEventHandler* handler) { handler->WorldRailgunFired(actor, AttackPos, DamagePosition, Inflictor, flags); });
 }
 
 void EventManager::WorldThingGround(AActor* actor, FState* st)
@@ -783,8 +866,7 @@ void EventManager::WorldThingGround(AActor* actor, FState* st)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingGround(actor, st);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingGround(actor, st);
+	CallSubscribers(ESUB_WorldThingGround, false, [&](DStaticEventHandler* handler) { handler->WorldThingGround(actor, st); });
 }
 
 void EventManager::WorldThingRevived(AActor* actor)
@@ -795,8 +877,7 @@ void EventManager::WorldThingRevived(AActor* actor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingRevived(actor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingRevived(actor);
+	CallSubscribers(ESUB_WorldThingRevived, false, [&](DStaticEventHandler* handler) { handler->WorldThingRevived(actor); });
 }
 
 void EventManager::WorldThingDamaged(AActor* actor, AActor* inflictor, AActor* source, int damage, FName mod, int flags, DAngle angle)
@@ -807,8 +888,7 @@ void EventManager::WorldThingDamaged(AActor* actor, AActor* inflictor, AActor* s
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle);
+	CallSubscribers(ESUB_WorldThingDamaged, false, [&](DStaticEventHandler* handler) { handler->WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle); });
 }
 
 void EventManager::WorldThingDestroyed(AActor* actor)
@@ -821,8 +901,7 @@ void EventManager::WorldThingDestroyed(AActor* actor)
 	if (!(actor->ObjectFlags & OF_Spawned))
 		return;
 
-	for (DStaticEventHandler* handler = LastEventHandler; handler; handler = handler->prev)
-		handler->WorldThingDestroyed(actor);
+	CallSubscribers(ESUB_WorldThingDestroyed, true, [&](DStaticEventHandler* handler) { handler->WorldThingDestroyed(actor); });
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDestroyed(actor);
 }
@@ -831,16 +910,14 @@ void EventManager::WorldLinePreActivated(line_t* line, AActor* actor, int activa
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldLinePreActivated(line, actor, activationType, shouldactivate);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldLinePreActivated(line, actor, activationType, shouldactivate);
+	CallSubscribers(ESUB_WorldLinePreActivated, false, [&](DStaticEventHandler* handler) { handler->WorldLinePreActivated(line, actor, activationType, shouldactivate); });
 }
 
 void EventManager::WorldLineActivated(line_t* line, AActor* actor, int activationType)
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldLineActivated(line, actor, activationType);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldLineActivated(line, actor, activationType);
+	CallSubscribers(ESUB_WorldLineActivated, false, [&](DStaticEventHandler* handler) { handler->WorldLineActivated(line, actor, activationType); });
 }
 
 int EventManager::WorldSectorDamaged(sector_t* sector, AActor* source, int damage, FName damagetype, int part, DVector3 position, bool isradius)
@@ -998,16 +1075,14 @@ void EventManager::RenderOverlay(EHudState state)
 {
 	if (ShouldCallStatic(false)) staticEventManager.RenderOverlay(state);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->RenderOverlay(state);
+	CallSubscribers(ESUB_RenderOverlay, false, [&](DStaticEventHandler* handler) { handler->RenderOverlay(state); });
 }
 
 void EventManager::RenderUnderlay(EHudState state)
 {
 	if (ShouldCallStatic(false)) staticEventManager.RenderUnderlay(state);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->RenderUnderlay(state);
+	CallSubscribers(ESUB_RenderUnderlay, false, [&](DStaticEventHandler* handler) { handler->RenderUnderlay(state); });
 }
 
 bool EventManager::CheckUiProcessors()
@@ -447,6 +447,30 @@ struct FReplacedEvent
 	bool IsFinal;
 };
 
+// Events that only get dispatched to the handlers overriding them.
+enum EEventSubscription
+{
+	ESUB_WorldThingSpawned,
+	ESUB_WorldThingDied,
+	ESUB_WorldThingRevived,
+	ESUB_WorldThingDamaged,
+	ESUB_WorldThingDestroyed,
+	ESUB_WorldThingGround,
+	ESUB_WorldHitscanFired,
+	ESUB_WorldRailgunFired,
+	ESUB_WorldLinePreActivated,
+	ESUB_WorldLineActivated,
+	ESUB_WorldLightning,
+	ESUB_WorldTick,
+	ESUB_UiTick,
+	ESUB_PostUiTick,
+	ESUB_RenderFrame,
+	ESUB_RenderOverlay,
+	ESUB_RenderUnderlay,
+
+	NUM_EVENT_SUBSCRIPTIONS
+};
+
 struct EventManager
 {
 	FLevelLocals *Level = nullptr;
@@ -572,6 +596,15 @@ struct EventManager
 		}
 	}
 
+private:
+	// The handlers with a non-empty override of each event, in list order.
+	// These get rebuilt by the first event after the handler list has changed.
+	TArray<DStaticEventHandler*> Subscribers[NUM_EVENT_SUBSCRIPTIONS];
+	unsigned HandlerGeneration = 1;
+	unsigned SubscriberGeneration = 0;
+
+	void UpdateSubscribers();
+	template<class Func> void CallSubscribers(EEventSubscription event, bool backwards, Func call);
 };
 
  extern EventManager staticEventManager;
@@ -447,6 +447,11 @@ CCMD(listsnapshots)
 		if (snapshot->mBuffer != nullptr)
 		{
 			Printf("%s (%u -> %u bytes)\n", wadlevelinfos[i].MapName.GetChars(), snapshot->mCompressedSize, snapshot->mSize);
+			FCompressedBuffer *base = &wadlevelinfos[i].SnapshotBase;
+			if (base->mBuffer != nullptr)
+			{
+				Printf("    delta against a baseline of %u -> %u bytes\n", base->mCompressedSize, base->mSize);
+			}
 		}
 	}
 }
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <memory>
+#include <future>
 
 #include "i_time.h"
 
@@ -91,6 +92,7 @@
 #include "screenjob.h"
 #include "i_interface.h"
 #include "fs_findfile.h"
+#include "ctpl.h"
 
 
 static FRandom pr_dmspawn ("DMSpawn");
@@ -117,7 +119,7 @@ void	G_DoQuickSave ();
 void STAT_Serialize(FSerializer &file);
 
 CVARD_NAMED(Int, gameskill, skill, 2, CVAR_SERVERINFO|CVAR_LATCH, "sets the skill for the next newly started game")
-CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves (more readable but a larger files and a bit slower.
+CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves instead of the binary format (readable but larger files and a lot slower).
 CVAR (Int, deathmatch, 0, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR (Bool, chasedemo, false, 0);
 CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
@@ -1167,6 +1169,8 @@ void G_Ticker ()
 		AddCommandString ("toggle vid_fullscreen");
 	}
 
+	G_FinishPendingSave (false);
+
 	// do things to change the game state
 	oldgamestate = gamestate;
 	while (gameaction != ga_nothing)
@@ -2027,6 +2031,7 @@ void FinishLoadingCVars();
 
 void G_DoLoadGame ()
 {
+	G_FinishPendingSave(true);
 	SetupLoadingCVars();
 	bool hidecon;
 
@@ -2367,11 +2372,98 @@ static void PutSavePic (FileWriter *file, int width, int height)
 	}
 }
 
-void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description)
+//==========================================================================
+//
+// Savegames are finished on a worker thread.
+//
+// G_DoSaveGame only captures the serialized data. Compressing it and writing
+// the zip to a temporary file are done in the background. G_FinishPendingSave
+// then checks on the game thread that the file can be opened again, because
+// the resource file code is not thread-safe, renames it over the real
+// savegame and reports the result. There is never more than
+// one save in flight: another save, loading a game or shutting down waits
+// for the previous one first.
+//
+//==========================================================================
+
+struct FPendingSave
+{
+	FString Filename;
+	FString Description;
+	FString PrevBackupSaveName;
+	bool OkForQuicksave;
+	bool ForceQuicksave;
+	TArray<FCompressedBuffer> Content;	// all buffers are owned by this
+	TArray<FString> ContentNames;
+	TArray<bool> Compress;
+};
+
+static ctpl::thread_pool SavePool(1);
+static std::unique_ptr<FPendingSave> PendingSave;
+static std::future<bool> PendingSaveResult;
+
+static bool WriteSaveGame(FPendingSave *save)
+{
+	for (unsigned i = 0; i < save->Content.Size(); i++)
+	{
+		if (save->Compress[i]) FSerializer::CompressBuffer(save->Content[i]);
+		save->Content[i].filename = save->ContentNames[i].GetChars();
+	}
+
+	FString tempname = save->Filename + ".tmp";
+	bool succeeded = WriteZip(tempname.GetChars(), save->Content.Data(), save->Content.Size());
+
+	for (auto &buff : save->Content) buff.Clean();
+	return succeeded;
+}
+
+static bool InstallSaveGame(FPendingSave &save, bool written)
+{
+	FString tempname = save.Filename + ".tmp";
+	bool succeeded = false;
+
+	if (written)
+	{
+		// Check whether the file is ok by trying to open it.
+		FResourceFile *test = FResourceFile::OpenResourceFile(tempname.GetChars(), true);
+		if (test != nullptr)
+		{
+			delete test;
+			succeeded = RenameFile(tempname.GetChars(), save.Filename.GetChars());
+		}
+	}
+	if (!succeeded) RemoveFile(tempname.GetChars());
+	return succeeded;
+}
+
+static void SaveGameFinished(FPendingSave &save, bool succeeded)
+{
+	if (succeeded)
+	{
+		savegameManager.NotifyNewSave(save.Filename, save.Description, save.OkForQuicksave, save.ForceQuicksave);
+
+		if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), save.Filename.GetChars());
+		else Printf("%s\n", GStrings.GetString("GGSAVED"));
+	}
+	else
+	{
+		// Don't let a reborn try to load what failed to save.
+		if (BackupSaveName.Compare(save.Filename) == 0) BackupSaveName = save.PrevBackupSaveName;
+		Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
+	}
+}
+
+void G_FinishPendingSave(bool wait)
 {
-	TArray<FCompressedBuffer> savegame_content;
-	TArray<FString> savegame_filenames;
+	if (PendingSave == nullptr) return;
+	if (!wait && PendingSaveResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+	auto save = std::move(PendingSave);
+	SaveGameFinished(*save, InstallSaveGame(*save, PendingSaveResult.get()));
+}
 
+void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description)
+{
 	char buf[100];
 
 	// Do not even try, if we're not in a level. (Can happen after
@@ -2381,6 +2473,8 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		return;
 	}
 
+	G_FinishPendingSave(true);
+
 	if (demoplayback)
 	{
 		filename = G_BuildSaveName ("demosave");
@@ -2392,7 +2486,7 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	insave = true;
 	try
 	{
-		level.SnapshotLevel();
+		level.SnapshotLevel(false);
 	}
 	catch(CRecoverableError &err)
 	{
@@ -2419,7 +2513,7 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	FSerializer savegameglobals;	// and this for non-level related info that must be saved.
 
 	savegameinfo.OpenWriter(true);
-	savegameglobals.OpenWriter(save_formatted);
+	savegameglobals.OpenWriter(true, !save_formatted);
 
 	SaveVersion = SAVEVER;
 	PutSavePic(&savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
@@ -2468,54 +2562,51 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		savegameglobals("nextskill", NextSkill);
 	}
 
+	auto save = std::make_unique<FPendingSave>();
+	save->Filename = filename;
+	save->Description = description;
+	save->PrevBackupSaveName = BackupSaveName;
+	save->OkForQuicksave = okForQuicksave;
+	save->ForceQuicksave = forceQuicksave;
+
 	auto picdata = savepic.GetBuffer();
-	FCompressedBuffer bufpng = { picdata->size(), picdata->size(), FileSys::METHOD_STORED, static_cast<unsigned int>(crc32(0, &(*picdata)[0], picdata->size())), (char*)&(*picdata)[0] };
-
-	savegame_content.Push(bufpng);
-	savegame_filenames.Push("savepic.png");
-	savegame_content.Push(savegameinfo.GetCompressedOutput());
-	savegame_filenames.Push("info.json");
-	savegame_content.Push(savegameglobals.GetCompressedOutput());
-	savegame_filenames.Push("globals.json");
-	G_WriteSnapshots (savegame_filenames, savegame_content);
-	
-	for (unsigned i = 0; i < savegame_content.Size(); i++)
-		savegame_content[i].filename = savegame_filenames[i].GetChars();
+	FCompressedBuffer bufpng = { picdata->size(), picdata->size(), FileSys::METHOD_STORED, static_cast<unsigned int>(crc32(0, &(*picdata)[0], picdata->size())), new char[picdata->size()] };
+	memcpy(bufpng.mBuffer, &(*picdata)[0], picdata->size());
 
-	bool succeeded = false;
+	save->Content.Push(bufpng);
+	save->ContentNames.Push("savepic.png");
+	save->Content.Push(savegameinfo.GetStoredOutput());
+	save->ContentNames.Push("info.json");
+	save->Content.Push(savegameglobals.GetStoredOutput());
+	save->ContentNames.Push("globals.json");
+	G_WriteSnapshots (save->ContentNames, save->Content);
 
-	if (WriteZip(filename.GetChars(), savegame_content.Data(), savegame_content.Size()))
+	// The snapshots of other hub levels stay with their level info, so the worker needs its own copy.
+	// The one for the current level was only made for this save and can be handed over as it is.
+	save->Compress.Resize(save->Content.Size());
+	for (unsigned i = 0; i < save->Content.Size(); i++)
 	{
-		// Check whether the file is ok by trying to open it.
-		FResourceFile *test = FResourceFile::OpenResourceFile(filename.GetChars(), true);
-		if (test != nullptr)
+		auto &buff = save->Content[i];
+		save->Compress[i] = i > 0 && buff.mMethod == FileSys::METHOD_STORED;
+		if (i < 3) continue;
+		if (buff.mBuffer == level.info->Snapshot.mBuffer)
 		{
-			delete test;
-			succeeded = true;
+			level.info->Snapshot.mBuffer = nullptr;
+		}
+		else
+		{
+			auto copy = new char[buff.mCompressedSize];
+			memcpy(copy, buff.mBuffer, buff.mCompressedSize);
+			buff.mBuffer = copy;
 		}
 	}
 
-	if (succeeded)
-	{
-		savegameManager.NotifyNewSave(filename, description, okForQuicksave, forceQuicksave);
-		BackupSaveName = filename;
-
-		if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), filename.GetChars());
-		else Printf("%s\n", GStrings.GetString("GGSAVED"));
-	}
-	else
-	{
-		Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
-	}
-
-
-	// delete the JSON buffers we created just above. Everything else will
-	// either still be needed or taken care of automatically.
-	savegame_content[1].Clean();
-	savegame_content[2].Clean();
-
 	// We don't need the snapshot any longer.
 	level.info->Snapshot.Clean();
+
+	BackupSaveName = filename;
+	PendingSave = std::move(save);
+	PendingSaveResult = SavePool.push([save = PendingSave.get()](int) { return WriteSaveGame(save); });
 		
 	insave = false;
 
@@ -67,6 +67,9 @@ void G_DoLoadGame (void);
 void G_SaveGame (const char *filename, const char *description);
 // Called by messagebox
 void G_DoQuickSave ();
+// Reports a savegame written in the background once it is done. With 'wait'
+// this blocks until then.
+void G_FinishPendingSave (bool wait);
 
 // Only called by startup code.
 void G_RecordDemo (const char* name);
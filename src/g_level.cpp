@@ -1297,6 +1297,7 @@ bool FLevelLocals::DoCompleted (FString nextlevel, wbstartstruct_t &wminfo)
 		else
 		{ // Make sure we don't have a snapshot lying around from before.
 			info->Snapshot.Clean();
+			info->SnapshotBase.Clean();
 		}
 	}
 	else
@@ -1967,6 +1968,13 @@ void G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buf
 			filenames.Push(filename);
 			buffers.Push(wadlevelinfos[i].Snapshot);
 		}
+		if (wadlevelinfos[i].SnapshotBase.mCompressedSize > 0)
+		{
+			filename.Format("%s.mapbase.json", wadlevelinfos[i].MapName.GetChars());
+			filename.ToLower();
+			filenames.Push(filename);
+			buffers.Push(wadlevelinfos[i].SnapshotBase);
+		}
 	}
 	if (TheDefaultLevelInfo.Snapshot.mCompressedSize > 0)
 	{
@@ -1975,6 +1983,13 @@ void G_WriteSnapshots(TArray<FString> &filenames, TArray<FCompressedBuffer> &buf
 		filenames.Push(filename);
 		buffers.Push(TheDefaultLevelInfo.Snapshot);
 	}
+	if (TheDefaultLevelInfo.SnapshotBase.mCompressedSize > 0)
+	{
+		filename.Format("%s.mapdbase.json", TheDefaultLevelInfo.MapName.GetChars());
+		filename.ToLower();
+		filenames.Push(filename);
+		buffers.Push(TheDefaultLevelInfo.SnapshotBase);
+	}
 }
 
 //==========================================================================
@@ -2033,6 +2048,12 @@ void G_ReadSnapshots(FResourceFile *resf)
 	{
 		auto name = resf->getName(j);
 		auto ptr = strstr(name, ".map.json");
+		bool base = false;
+		if (ptr == nullptr)
+		{
+			ptr = strstr(name, ".mapbase.json");
+			base = true;
+		}
 		if (ptr != nullptr)
 		{
 			ptrdiff_t maplen = ptr - name;
@@ -2040,17 +2061,23 @@ void G_ReadSnapshots(FResourceFile *resf)
 			i = FindLevelInfo(mapname.GetChars());
 			if (i != nullptr)
 			{
-				i->Snapshot = resf->GetRawData(j);
+				(base ? i->SnapshotBase : i->Snapshot) = resf->GetRawData(j);
 			}
 		}
 		else
 		{
 			auto ptr = strstr(name, ".mapd.json");
+			base = false;
+			if (ptr == nullptr)
+			{
+				ptr = strstr(name, ".mapdbase.json");
+				base = true;
+			}
 			if (ptr != nullptr)
 			{
 				ptrdiff_t maplen = ptr - name;
 				FString mapname(name, (size_t)maplen);
-				TheDefaultLevelInfo.Snapshot = resf->GetRawData(j);
+				(base ? TheDefaultLevelInfo.SnapshotBase : TheDefaultLevelInfo.Snapshot) = resf->GetRawData(j);
 			}
 		}
 	}
@@ -2261,6 +2288,7 @@ void FLevelLocals::Tick ()
 	{
 		memset (&Scrolls[0], 0, sizeof(Scrolls[0])*Scrolls.Size());
 	}
+	GeneratedReject.CheckActivation(maptime);
 }
 
 //==========================================================================
@@ -2304,6 +2332,10 @@ void FLevelLocals::Mark()
 	{
 		GC::Mark(c);
 	}
+	for (auto &c : LookCandidates)
+	{
+		GC::Mark(c);
+	}
 	for (auto &s : sectorPortals)
 	{
 		GC::Mark(s.mSkybox);
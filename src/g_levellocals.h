@@ -51,6 +51,9 @@
 #include "p_effect.h"
 #include "d_player.h"
 #include "p_destructible.h"
+#include "p_soundgraph.h"
+#include "p_subsectorgrid.h"
+#include "p_rejectgen.h"
 #include "r_data/r_sections.h"
 #include "r_data/r_canvastexture.h"
 #include "r_data/r_interpolate.h"
@@ -163,6 +166,8 @@ private:
 	void UpdatePortal(FLinePortal *port);
 	void CollectLinkedPortals();
 	void CreateLinkedPortals();
+	void BuildLinkedPortalBlocks();
+	bool CollectPortalCandidates(const DVector2 &position, double checkradius);
 	bool ChangePortalLine(line_t *line, int destid);
 	void AddDisplacementForPortal(FSectorPortal *portal);
 	void AddDisplacementForPortal(FLinePortal *portal);
@@ -176,7 +181,7 @@ private:
 	void PlayerSpawnPickClass (int playernum);
 
 public:
-	void SnapshotLevel();
+	void SnapshotLevel(bool compress = true);
 	void UnSnapshotLevel(bool hubLoad);
 
 	void FinalizePortals();
@@ -280,6 +285,7 @@ private:
 	FPortalBits processMask;
 	TArray<FLinePortal*> foundPortals;
 	TArray<int> groupsToCheck;
+	TArray<unsigned> portalCandidates;
 
 public:
 
@@ -465,7 +471,10 @@ public:
 	TArray<subsector_t> gamesubsectors;
 	TArray<node_t> gamenodes;
 	node_t *headgamenode;
+	FSubsectorGrid RenderSubsectorGrid;
+	FSubsectorGrid GameSubsectorGrid;	// only built if there are separate game nodes
 	TArray<uint8_t> rejectmatrix;
+	FGeneratedReject GeneratedReject;	// only if the map has no REJECT. Checked by P_CheckSight.
 	TArray<zone_t>	Zones;
 	TArray<FPolyObj> Polyobjects;
 
@@ -534,6 +543,7 @@ public:
 	uint8_t		md5[16];			// for savegame validation. If the MD5 does not match the savegame won't be loaded.
 	int			time;			// time in the hub
 	int			maptime;			// time in the map
+	unsigned	GeometryStamp = 0;	// incremented whenever planes, plane flags, 3D floors or polyobjects change. Never serialized.
 	int			totaltime;		// time in the game
 	int			starttime;
 	int			partime;
@@ -678,13 +688,15 @@ public:
 	int			DefaultEnvironment;		// Default sound environment.
 
 	DSeqNode *SequenceListHead;
+	FSoundGraph SoundGraph;
 
 	// [RH] particle globals
 	uint32_t			OldestParticle; // [MC] Oldest particle for replacing with SPF_REPLACE
 	uint32_t			ActiveParticles;
 	uint32_t			InactiveParticles;
 	TArray<particle_t>	Particles;
-	TArray<uint16_t>	ParticlesInSubsec;
+	TArray<particlelink_t>	ParticleLinks;
+	TArray<uint32_t>	ParticlesInSubsec;
 	FThinkerCollection Thinkers;
 
 	TArray<DVector2>	Scrolls;		// NULL if no DScrollers in this level
@@ -721,6 +733,7 @@ public:
 
 	// links to global game objects
 	TArray<TObjPtr<AActor *>> CorpseQueue;
+	TArray<TObjPtr<AActor *>> LookCandidates;	// monsters that may look for a target in the next tic. Never serialized.
 	TObjPtr<DFraggleThinker *> FraggleScriptThinker = MakeObjPtr<DFraggleThinker*>(nullptr);
 	TObjPtr<DACSThinker*> ACSThinker = MakeObjPtr<DACSThinker*>(nullptr);
 
@@ -212,14 +212,21 @@ void G_ClearSnapshots (void)
 	for (unsigned int i = 0; i < wadlevelinfos.Size(); i++)
 	{
 		wadlevelinfos[i].Snapshot.Clean();
+		wadlevelinfos[i].SnapshotBase.Clean();
 	}
 
 	// Clear current levels' snapshots just in case they are not defined via MAPINFO,
 	// so they were not handled by the loop above
 	if (primaryLevel && primaryLevel->info)
+	{
 		primaryLevel->info->Snapshot.Clean();
+		primaryLevel->info->SnapshotBase.Clean();
+	}
 	if (currentVMLevel && currentVMLevel->info)
+	{
 		currentVMLevel->info->Snapshot.Clean();
+		currentVMLevel->info->SnapshotBase.Clean();
+	}
 
 	// Since strings are only locked when snapshotting a level, unlock them
 	// all now, since we got rid of all the snapshots that cared about them.
@@ -367,6 +367,7 @@ struct level_info_t
 	int8_t		WallVertLight, WallHorizLight;
 	int			musicorder;
 	FileSys::FCompressedBuffer	Snapshot;
+	FileSys::FCompressedBuffer	SnapshotBase;	// what Snapshot is a delta against
 	TArray<acsdefered_t> deferred;
 	float		skyspeed1;
 	float		skyspeed2;
@@ -449,6 +450,7 @@ struct level_info_t
 	~level_info_t()
 	{
 		Snapshot.Clean();
+		SnapshotBase.Clean();
 		ClearDefered();
 	}
 	void Reset();
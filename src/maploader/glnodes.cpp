@@ -993,7 +993,7 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 typedef TArray<uint8_t> MemFile;
 
 
-static FString CreateCacheName(MapData *map, bool create)
+FString CreateCacheName(MapData *map, bool create, const char *extension)
 {
 	FString path = M_GetCachePath(create);
 	FString lumpname = fileSystem.GetFileFullPath(map->lumpnum).c_str();
@@ -1003,7 +1003,7 @@ static FString CreateCacheName(MapData *map, bool create)
 
 	lumpname.ReplaceChars('/', '%');
 	lumpname.ReplaceChars(':', '$');
-	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ".gzc";
+	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << extension;
 	return path;
 }
 
@@ -1119,7 +1119,7 @@ void MapLoader::CreateCachedNodes(MapData *map)
 	}
 	memcpy(&compressed[offset - 4], "ZGL3", 4);
 
-	FString path = CreateCacheName(map, true);
+	FString path = CreateCacheName(map, true, ".gzc");
 	FileWriter *fw = FileWriter::Open(path.GetChars());
 
 	if (fw != nullptr)
@@ -1146,7 +1146,7 @@ bool MapLoader::CheckCachedNodes(MapData *map)
 	uint32_t numlin;
 	TArray<uint32_t> verts;
 
-	FString path = CreateCacheName(map, false);
+	FString path = CreateCacheName(map, false, ".gzc");
 	FileReader fr;
 
 	if (!fr.OpenFile(path.GetChars())) return false;
@@ -97,6 +97,8 @@ CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, genlightmaps, false, CVAR_GLOBALCONFIG);
 CVAR (Bool, ignorelightmaplump, false, CVAR_GLOBALCONFIG);
+CVAR (Bool, genreject, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG|CVAR_SERVERINFO);
+EXTERN_CVAR(Bool, gl_cachenodes)
 EXTERN_CVAR(Bool, lm_dynlights);
 
 inline bool P_LoadBuildMap(uint8_t *mapdata, size_t len, FMapThing **things, int *numthings)
@@ -2850,6 +2852,23 @@ void MapLoader::LoadReject (MapData * map, bool junk)
 	}
 }
 
+//===========================================================================
+//
+// Without a usable REJECT, calculate one in the background.
+// It gets cached along with the nodes.
+//
+//===========================================================================
+
+void MapLoader::GenerateReject(MapData *map)
+{
+	if (!genreject || Level->rejectmatrix.Size() > 0)
+		return;
+
+	uint8_t checksum[16];
+	map->GetChecksum(checksum);
+	Level->GeneratedReject.Start(Level, CreateCacheName(map, gl_cachenodes, ".rej"), checksum, gl_cachenodes);
+}
+
 //===========================================================================
 //
 //
@@ -3486,6 +3505,8 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	
 	// set the head node for gameplay purposes. If the separate gamenodes array is not empty, use that, otherwise use the render nodes.
 	Level->headgamenode = Level->gamenodes.Size() > 0 ? &Level->gamenodes[Level->gamenodes.Size() - 1] : Level->nodes.Size() ? &Level->nodes[Level->nodes.Size() - 1] : nullptr;
+	Level->RenderSubsectorGrid.Build(Level, Level->HeadNode(), Level->subsectors.Size());
+	if (Level->gamenodes.Size() > 0) Level->GameSubsectorGrid.Build(Level, Level->headgamenode, Level->gamesubsectors.Size());
 
 	LoadBlockMap(map);
 
@@ -3558,6 +3579,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	PO_Init();				// Initialize the polyobjs
 	if (!Level->IsReentering())
 		Level->FinalizePortals();	// finalize line portals after polyobjects have been initialized. This info is needed for properly flagging them.
+	GenerateReject(map);	// needs to know the polyobjects and portals
 
 	InitLightmapTiles(map);
 
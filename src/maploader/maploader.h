@@ -98,6 +98,8 @@ typedef TMap<FString,FMissingCount> FMissingTextureTracker;
 struct FLevelLocals;
 struct MapData;
 
+FString CreateCacheName(MapData *map, bool create, const char *extension);
+
 class MapLoader
 {
 	friend class UDMFParser;
@@ -298,6 +300,7 @@ public:
 	void LoadSideDefs2(MapData *map, FMissingTextureTracker &missingtex);
 	void LoadBlockMap(MapData * map);
 	void LoadReject(MapData * map, bool junk);
+	void GenerateReject(MapData *map);
 	void LoadBehavior(MapData * map);
 	void GetPolySpots(MapData * map, TArray<FNodeBuilder::FPolyStart> &spots, TArray<FNodeBuilder::FPolyStart> &anchors);
 	void GroupLines(bool buildmap);
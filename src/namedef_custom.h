@@ -275,6 +275,9 @@ xx(WeaponScaleX)
 xx(WeaponScaleY)
 xx(ReadySound)
 xx(A_WeaponReady)
+xx(A_Look)
+xx(A_LookEx)
+xx(A_Chase)
 
 // PlayerPawn member fields
 xx(ColorRangeStart)
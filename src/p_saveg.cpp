@@ -63,6 +63,7 @@
 #include "s_music.h"
 #include "model.h"
 #include "d_net.h"
+#include "m_crc32.h"
 
 EXTERN_CVAR(Bool, save_formatted)
 
@@ -1076,13 +1077,259 @@ void FLevelLocals::Serialize(FSerializer &arc, bool hubload)
 
 }
 
+//==========================================================================
+//
+// Snapshot deltas
+//
+// When a hub level is left, only the first snapshot is stored as a whole.
+// It becomes the level's baseline, and every later snapshot is stored as a
+// list of ranges copied from the baseline plus the bytes that are not found
+// there. Since most of a level stays as it was between two visits, the delta
+// is small and compressing it is far cheaper than compressing the entire
+// level again. If the delta grows too large compared to the baseline, the
+// new snapshot becomes the baseline instead.
+//
+// A snapshot that is not a delta is an ordinary serializer document, so
+// older snapshots and the full ones made for savegames are still read as
+// they are. Deltas can end up in savegames from SAVEVER 4562 on.
+//
+//==========================================================================
+
+static const uint8_t SnapshotDeltaMagic[4] = { 'G', 'Z', 'S', 'D' };
+enum { DELTA_BLOCK = 32, DELTA_HASHMUL = 0x01000193 };
+
+static void PutVarint(TArray<uint8_t> &out, size_t v)
+{
+	while (v >= 0x80)
+	{
+		out.Push(uint8_t(v | 0x80));
+		v >>= 7;
+	}
+	out.Push(uint8_t(v));
+}
+
+static bool GetVarint(const uint8_t *&p, const uint8_t *end, size_t &v)
+{
+	v = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7)
+	{
+		uint8_t b = *p++;
+		v |= size_t(b & 0x7f) << shift;
+		if (!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+template<class T>
+static void AppendBytes(TArray<T> &out, const void *data, size_t len)
+{
+	unsigned start = out.Size();
+	out.Resize(start + (unsigned)len);
+	if (len > 0) memcpy(&out[start], data, len);
+}
+
+static void PutDeltaOp(TArray<uint8_t> &out, const uint8_t *add, size_t addlen, size_t copyofs, size_t copylen)
+{
+	PutVarint(out, addlen);
+	AppendBytes(out, add, addlen);
+	PutVarint(out, copylen);
+	PutVarint(out, copyofs);
+}
+
+static void StartDelta(TArray<uint8_t> &out, const uint8_t *base, size_t baselen)
+{
+	uint32_t crc = crc32(0, base, (unsigned)baselen);
+	AppendBytes(out, SnapshotDeltaMagic, 4);
+	PutVarint(out, baselen);
+	PutVarint(out, crc);
+}
+
+// The baseline is indexed in aligned blocks, the new data is searched with a rolling hash
+// at every position and each match is then grown in both directions. Repeated blocks are
+// only indexed once, since they would all land in the same probe chain.
+static void MakeDelta(TArray<uint8_t> &out, const uint8_t *base, size_t baselen, const uint8_t *data, size_t len)
+{
+	StartDelta(out, base, baselen);
+
+	uint32_t power = 1;
+	for (int i = 1; i < DELTA_BLOCK; i++) power *= DELTA_HASHMUL;
+
+	auto hashblock = [](const uint8_t *p)
+	{
+		uint32_t h = 0;
+		for (int i = 0; i < DELTA_BLOCK; i++) h = h * DELTA_HASHMUL + p[i];
+		return h;
+	};
+
+	size_t numblocks = baselen / DELTA_BLOCK;
+	unsigned tablesize = 1024;
+	while (tablesize < numblocks * 2) tablesize <<= 1;
+	TArray<uint32_t> table(tablesize, true);	// block number + 1
+	TArray<uint32_t> hashes(tablesize, true);
+	memset(table.Data(), 0, tablesize * sizeof(uint32_t));
+
+	// Returns the slot holding a block equal to the one at p, or the empty slot where it would go.
+	auto findblock = [&](const uint8_t *p, uint32_t h)
+	{
+		unsigned slot = h & (tablesize - 1);
+		while (table[slot] != 0)
+		{
+			if (hashes[slot] == h && memcmp(base + size_t(table[slot] - 1) * DELTA_BLOCK, p, DELTA_BLOCK) == 0) break;
+			slot = (slot + 1) & (tablesize - 1);
+		}
+		return slot;
+	};
+
+	for (size_t b = 0; b < numblocks; b++)
+	{
+		const uint8_t *block = base + b * DELTA_BLOCK;
+		uint32_t h = hashblock(block);
+		unsigned slot = findblock(block, h);
+		if (table[slot] == 0)
+		{
+			table[slot] = uint32_t(b + 1);
+			hashes[slot] = h;
+		}
+	}
+
+	size_t addstart = 0;
+	size_t pos = 0;
+	uint32_t hash = len >= DELTA_BLOCK ? hashblock(data) : 0;
+	while (pos + DELTA_BLOCK <= len)
+	{
+		size_t matchofs = 0, matchlen = 0;
+		unsigned slot = findblock(data + pos, hash);
+		if (table[slot] != 0)
+		{
+			matchofs = size_t(table[slot] - 1) * DELTA_BLOCK;
+			matchlen = DELTA_BLOCK;
+		}
+
+		if (matchlen == 0)
+		{
+			if (pos + DELTA_BLOCK < len) hash = (hash - data[pos] * power) * DELTA_HASHMUL + data[pos + DELTA_BLOCK];
+			pos++;
+			continue;
+		}
+
+		size_t start = pos;
+		while (start > addstart && matchofs > 0 && base[matchofs - 1] == data[start - 1])
+		{
+			start--;
+			matchofs--;
+			matchlen++;
+		}
+		while (start + matchlen < len && matchofs + matchlen < baselen && base[matchofs + matchlen] == data[start + matchlen])
+		{
+			matchlen++;
+		}
+		PutDeltaOp(out, data + addstart, start - addstart, matchofs, matchlen);
+		pos = addstart = start + matchlen;
+		if (pos + DELTA_BLOCK <= len) hash = hashblock(data + pos);
+	}
+	if (addstart < len)
+	{
+		PutDeltaOp(out, data + addstart, len - addstart, 0, 0);
+	}
+}
+
+static bool ApplyDelta(TArray<char> &out, const uint8_t *base, size_t baselen, const uint8_t *delta, size_t deltalen)
+{
+	const uint8_t *p = delta + 4;
+	const uint8_t *end = delta + deltalen;
+	size_t size, crc;
+
+	if (!GetVarint(p, end, size) || !GetVarint(p, end, crc)) return false;
+	if (size != baselen || crc != crc32(0, base, (unsigned)baselen)) return false;
+
+	out.Clear();
+	while (p < end)
+	{
+		size_t addlen, copylen, copyofs;
+		if (!GetVarint(p, end, addlen) || addlen > size_t(end - p)) return false;
+		AppendBytes(out, p, addlen);
+		p += addlen;
+		if (!GetVarint(p, end, copylen) || !GetVarint(p, end, copyofs)) return false;
+		if (copyofs > baselen || copylen > baselen - copyofs) return false;
+		AppendBytes(out, base + copyofs, copylen);
+	}
+	return true;
+}
+
+static bool IsSnapshotDelta(const char *data, size_t len)
+{
+	return len >= 4 && !memcmp(data, SnapshotDeltaMagic, 4);
+}
+
+static bool ReadSnapshotBuffer(FCompressedBuffer &buff, TArray<char> &out)
+{
+	out.Resize((unsigned)buff.mSize);
+	buff.Decompress(out.Data());
+	return crc32(0, (const uint8_t *)out.Data(), (unsigned)out.Size()) == buff.mCRC32;
+}
+
+static FCompressedBuffer MakeCompressedBuffer(const uint8_t *data, size_t len)
+{
+	FCompressedBuffer buff;
+	buff.filename = nullptr;
+	buff.mSize = buff.mCompressedSize = len;
+	buff.mCRC32 = crc32(0, data, (unsigned)len);
+	buff.mMethod = FileSys::METHOD_STORED;
+	buff.mBuffer = new char[len];
+	memcpy(buff.mBuffer, data, len);
+	FSerializer::CompressBuffer(buff);
+	return buff;
+}
+
+static FCompressedBuffer MakeSnapshotDelta(FCompressedBuffer &base, const uint8_t *data, size_t len)
+{
+	TArray<uint8_t> delta;
+	TArray<char> basedata;
+
+	if (base.mBuffer != nullptr && ReadSnapshotBuffer(base, basedata))
+	{
+		MakeDelta(delta, (const uint8_t *)basedata.Data(), basedata.Size(), data, len);
+	}
+	if (delta.Size() == 0 || delta.Size() > basedata.Size() / 4)
+	{
+		// start over with this snapshot as the baseline.
+		base.Clean();
+		base = MakeCompressedBuffer(data, len);
+		delta.Clear();
+		StartDelta(delta, data, len);
+		PutDeltaOp(delta, nullptr, 0, 0, len);
+	}
+	return MakeCompressedBuffer(delta.Data(), delta.Size());
+}
+
+//==========================================================================
+//
+// Returns the full serialized snapshot of a level
+//
+//==========================================================================
+
+static bool ExpandSnapshot(level_info_t *info, TArray<char> &out)
+{
+	if (!ReadSnapshotBuffer(info->Snapshot, out)) return false;
+	if (!IsSnapshotDelta(out.Data(), out.Size())) return true;
+
+	TArray<char> basedata;
+	if (info->SnapshotBase.mBuffer == nullptr || !ReadSnapshotBuffer(info->SnapshotBase, basedata)) return false;
+
+	TArray<char> delta = std::move(out);
+	return ApplyDelta(out, (const uint8_t *)basedata.Data(), basedata.Size(), (const uint8_t *)delta.Data(), delta.Size());
+}
+
 //==========================================================================
 //
 // Archives the current level
 //
+// Savegames get the full state of the current level, compressed later,
+// hub transitions store a delta against the level's baseline.
+//
 //==========================================================================
 
-void FLevelLocals::SnapshotLevel()
+void FLevelLocals::SnapshotLevel(bool compress)
 {
 	info->Snapshot.Clean();
 
@@ -1090,11 +1337,20 @@ void FLevelLocals::SnapshotLevel()
 	{
 		FDoomSerializer arc(this);
 
-		if (arc.OpenWriter(save_formatted))
+		if (arc.OpenWriter(true, !save_formatted))
 		{
 			SaveVersion = SAVEVER;
 			Serialize(arc, false);
-			info->Snapshot = arc.GetCompressedOutput();
+			if (!compress)
+			{
+				info->Snapshot = arc.GetStoredOutput();
+			}
+			else
+			{
+				unsigned len;
+				auto data = arc.GetOutput(&len);
+				info->Snapshot = MakeSnapshotDelta(info->SnapshotBase, (const uint8_t *)data, len);
+			}
 		}
 	}
 }
@@ -1114,7 +1370,8 @@ void FLevelLocals::UnSnapshotLevel(bool hubLoad)
 	if (info->isValid())
 	{
 		FDoomSerializer arc(this);
-		if (!arc.OpenReader(&info->Snapshot))
+		TArray<char> data;
+		if (!ExpandSnapshot(info, data) || !arc.OpenReader(std::move(data)))
 		{
 			I_Error("Failed to load savegame");
 			return;
@@ -333,6 +333,7 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	ACSThinker = nullptr;
 	FraggleScriptThinker = nullptr;
 	CorpseQueue.Clear();
+	LookCandidates.Clear();
 	canvasTextureInfo.EmptyList();
 	sections.Clear();
 	segs.Clear();
@@ -351,7 +352,11 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	gamenodes.Reset();
 	subsectors.Clear();
 	gamesubsectors.Reset();
+	RenderSubsectorGrid.Clear();
+	GameSubsectorGrid.Clear();
 	rejectmatrix.Clear();
+	GeneratedReject.Stop();
+	SoundGraph.Clear();
 	Zones.Clear();
 	blockmap.Clear();
 	Polyobjects.Clear();
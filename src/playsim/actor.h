@@ -821,6 +821,8 @@ public:
 	virtual void PostSerialize() override;
 	virtual void PostBeginPlay() override;		// Called immediately before the actor's first tick
 	virtual void Tick() override;
+	bool SleepTick() override;
+	bool CanSleep();
 	void EnableNetworking(const bool enable) override;
 
 	void CalcBones(bool recalc);
@@ -1320,6 +1322,8 @@ public:
 	sector_t		*BlockingFloor;		// Sector that blocked the last move (floor plane slope)
 
 	uint32_t		freezetics;	// actor has actions completely frozen (including movement) for this many tics, but they still get Tick() calls
+	DVector3		SleepPos;	// position when the actor fell asleep. Not serialized, actors always wake up after loading.
+	int				TargetedTime;	// last maptime another actor ticked with this one as its target. Not serialized either.
 
 	int PoisonDamage; // Damage received per tic from poison.
 	FName PoisonDamageType; // Damage type dealt by poison.
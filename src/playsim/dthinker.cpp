@@ -49,6 +49,7 @@
 #include "p_visualthinker.h"
 
 static int ThinkCount;
+static int SleepCount;
 static cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
@@ -69,7 +70,9 @@ struct ProfileInfo
 
 static TMap<FName, ProfileInfo> Profiles;
 static unsigned int profilethinkers, profilelimit;
-DThinker *NextToThink;
+
+// Lists shorter than this are simply scanned by the iterators.
+enum { FAST_ITERATE_MIN = 32 };
 
 //==========================================================================
 //
@@ -103,6 +106,7 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 	int i, count;
 
 	ThinkCount = 0;
+	SleepCount = 0;
 	ThinkCycles.Reset();
 	BotSupportCycles.Reset();
 	ActionCycles.Reset();
@@ -110,6 +114,8 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 	ThinkCycles.Clock();
 
+	CompactThinkers();
+
 	bool dolights;
 	if ((gl_lights && V_IsHardwareRenderer()) || (r_dynlights && V_IsSoftwareRenderer()) || Level->lightmaps)
 	{
@@ -144,7 +150,13 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 	if (!profilethinkers)
 	{
 		// Tick every thinker left from last time
-		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
+		for (i = STAT_FIRST_THINKING; i < STAT_DEFAULT; ++i)
+		{
+			Thinkers[i].TickThinkers(nullptr);
+		}
+		// The players have moved, the monsters are next.
+		P_PrepareTargetSearch(Level);
+		for (i = STAT_DEFAULT; i <= MAX_STATNUM; ++i)
 		{
 			Thinkers[i].TickThinkers(nullptr);
 		}
@@ -174,7 +186,13 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 	{
 		Profiles.Clear();
 		// Tick every thinker left from last time
-		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
+		for (i = STAT_FIRST_THINKING; i < STAT_DEFAULT; ++i)
+		{
+			Thinkers[i].ProfileThinkers(nullptr);
+		}
+		// The players have moved, the monsters are next.
+		P_PrepareTargetSearch(Level);
+		for (i = STAT_DEFAULT; i <= MAX_STATNUM; ++i)
 		{
 			Thinkers[i].ProfileThinkers(nullptr);
 		}
@@ -296,6 +314,23 @@ void FThinkerCollection::DestroyAllThinkers(bool fullgc)
 	}
 }
 
+//==========================================================================
+//
+// Closes the gaps left by removed thinkers. This must not be called while
+// thinkers are ticking.
+//
+//==========================================================================
+
+void FThinkerCollection::CompactThinkers()
+{
+	for (int i = 0; i <= MAX_STATNUM; i++)
+	{
+		Thinkers[i].Compact();
+		FreshThinkers[i].Compact();
+	}
+	Thinkers[MAX_STATNUM + 1].Compact();
+}
+
 //==========================================================================
 //
 //
@@ -341,7 +376,7 @@ void FThinkerCollection::SerializeThinkers(FSerializer &arc, bool hubLoad)
 							{
 								// This may be a player stored in their ancillary list. Remove
 								// them first before inserting them into the new list.
-								if (thinker->NextThinker != nullptr)
+								if (thinker->OwnerList != nullptr)
 								{
 									thinker->Remove();
 								}
@@ -382,32 +417,109 @@ void FThinkerCollection::SerializeThinkers(FSerializer &arc, bool hubLoad)
 
 void FThinkerList::AddTail(DThinker *thinker)
 {
-	assert(thinker->PrevThinker == nullptr && thinker->NextThinker == nullptr);
+	assert(thinker->OwnerList == nullptr);
 	assert(!(thinker->ObjectFlags & OF_EuthanizeMe));
-	if (Sentinel == nullptr)
+	thinker->OwnerList = this;
+	thinker->ListIndex = Items.Push(thinker);
+	ClassSlots[thinker->GetClass()].Push(thinker->ListIndex);
+	NumLive++;
+	// The lists are roots, so a thinker linked while the GC is propagating needs to be marked here.
+	GC::WriteBarrier(thinker);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FThinkerList::Remove(DThinker *thinker)
+{
+	assert(thinker->OwnerList == this && Items[thinker->ListIndex] == thinker);
+	Items[thinker->ListIndex] = nullptr;
+	thinker->OwnerList = nullptr;
+	NumLive--;
+	while (Head < Items.Size() && Items[Head] == nullptr)
 	{
-		// This cannot use CreateThinker because it must not be added to the list automatically.
-		Sentinel = (DThinker*)RUNTIME_CLASS(DThinker)->CreateNew();
-		Sentinel->ObjectFlags |= OF_Sentinel;
-		Sentinel->NextThinker = Sentinel;
-		Sentinel->PrevThinker = Sentinel;
-		GC::WriteBarrier(Sentinel);
+		Head++;
 	}
-	DThinker *tail = Sentinel->PrevThinker;
-	assert(tail->NextThinker == Sentinel);
-	thinker->PrevThinker = tail;
-	thinker->NextThinker = Sentinel;
-	tail->NextThinker = thinker;
-	Sentinel->PrevThinker = thinker;
-	GC::WriteBarrier(thinker, tail);
-	GC::WriteBarrier(thinker, Sentinel);
-	GC::WriteBarrier(tail, thinker);
-	GC::WriteBarrier(Sentinel, thinker);
 }
 
 //==========================================================================
 //
-// 
+// Removes the empty slots and renumbers the remaining thinkers.
+// Unless forced, this only happens if enough slots are empty.
+//
+//==========================================================================
+
+void FThinkerList::Compact(bool force)
+{
+	unsigned empty = Items.Size() - NumLive;
+	if (empty == 0 || (!force && NumLive > 0 && empty < Items.Size() / 4))
+	{
+		return;
+	}
+
+	// Classes without any thinkers left are dropped here, so that FindOnlyMatchingClass
+	// only has to look at what is in the list.
+	ClassSlots.Clear();
+
+	unsigned count = 0;
+	for (unsigned i = 0; i < Items.Size(); i++)
+	{
+		DThinker *thinker = Items[i];
+		if (thinker != nullptr)
+		{
+			thinker->ListIndex = count;
+			Items[count] = thinker;
+			ClassSlots[thinker->GetClass()].Push(count);
+			count++;
+		}
+	}
+	assert(count == NumLive);
+	Items.Resize(count);
+	Head = 0;
+	Generation++;
+}
+
+//==========================================================================
+//
+// Returns the only class in this list the iterator may find, if there is
+// exactly one. 'none' is set if nothing in the list can match.
+//
+//==========================================================================
+
+const PClass *FThinkerList::FindOnlyMatchingClass(const PClass *type, bool exact, bool &none) const
+{
+	if (exact)
+	{
+		auto slots = ClassSlots.CheckKey(type);
+		none = slots == nullptr || slots->Size() == 0;
+		return type;
+	}
+
+	const PClass *found = nullptr;
+	TMap<const PClass *, TArray<unsigned>>::ConstIterator it(ClassSlots);
+	const TMap<const PClass *, TArray<unsigned>>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		if (pair->Value.Size() > 0 && pair->Key->IsDescendantOf(type))
+		{
+			if (found != nullptr)
+			{
+				none = false;
+				return nullptr;
+			}
+			found = pair->Key;
+		}
+	}
+	none = found == nullptr;
+	return found;
+}
+
+//==========================================================================
+//
+//
 //
 //==========================================================================
 
@@ -433,18 +545,27 @@ DThinker *FThinkerCollection::FirstThinker(int statnum)
 
 //==========================================================================
 //
-// Mark the first thinker of each list
+// Mark all thinkers in the lists
 //
 //==========================================================================
 
+void FThinkerList::MarkThinkers()
+{
+	for (unsigned i = Head; i < Items.Size(); i++)
+	{
+		DObject *thinker = Items[i];
+		GC::Mark(thinker);
+	}
+}
+
 void FThinkerCollection::MarkRoots()
 {
 	for (int i = 0; i <= MAX_STATNUM; ++i)
 	{
-		GC::Mark(Thinkers[i].Sentinel);
-		GC::Mark(FreshThinkers[i].Sentinel);
+		Thinkers[i].MarkThinkers();
+		FreshThinkers[i].MarkThinkers();
 	}
-	GC::Mark(Thinkers[MAX_STATNUM + 1].Sentinel);
+	Thinkers[MAX_STATNUM + 1].MarkThinkers();
 }
 
 //==========================================================================
@@ -455,12 +576,7 @@ void FThinkerCollection::MarkRoots()
 
 DThinker *FThinkerList::GetHead() const
 {
-	if (Sentinel == nullptr || Sentinel->NextThinker == Sentinel)
-	{
-		return nullptr;
-	}
-	assert(Sentinel->NextThinker->PrevThinker == Sentinel);
-	return Sentinel->NextThinker;
+	return Head < Items.Size() ? Items[Head] : nullptr;
 }
 
 //==========================================================================
@@ -471,11 +587,14 @@ DThinker *FThinkerList::GetHead() const
 
 DThinker *FThinkerList::GetTail() const
 {
-	if (Sentinel == nullptr || Sentinel->PrevThinker == Sentinel)
+	for (unsigned i = Items.Size(); i > Head; i--)
 	{
-		return nullptr;
+		if (Items[i - 1] != nullptr)
+		{
+			return Items[i - 1];
+		}
 	}
-	return Sentinel->PrevThinker;
+	return nullptr;
 }
 
 //==========================================================================
@@ -486,7 +605,7 @@ DThinker *FThinkerList::GetTail() const
 
 bool FThinkerList::IsEmpty() const
 {
-	return Sentinel == nullptr || Sentinel->NextThinker == nullptr;
+	return NumLive == 0;
 }
 
 //==========================================================================
@@ -512,48 +631,48 @@ void FThinkerList::DestroyThinkers()
 bool FThinkerList::DoDestroyThinkers()
 {
 	bool error = false;
-	if (Sentinel != nullptr)
-	{
-		// Taking down the linked list live is far too dangerous in case something goes wrong. So first copy all elements into an array, take down the list and then destroy them.
 
-		TArray<DThinker *> toDelete;
-		DThinker *node = Sentinel->NextThinker;
-		while (node != Sentinel)
+	// Taking down the list live is far too dangerous in case something goes wrong. So first copy all elements into an array, clear the list and then destroy them.
+	TArray<DThinker *> toDelete;
+	toDelete.Grow(NumLive);
+	for (auto node : Items)
+	{
+		if (node != nullptr)
 		{
-			assert(node != nullptr);
-			auto next = node->NextThinker;
 			toDelete.Push(node);
-			node->NextThinker = node->PrevThinker = nullptr;	// clear the links
-			node = next;
+			node->OwnerList = nullptr;	// clear the links
 		}
-		Sentinel->NextThinker = Sentinel->PrevThinker = nullptr;
-		Sentinel->Destroy();
-		Sentinel = nullptr;
-		for (auto node : toDelete)
+	}
+	Items.Clear();
+	ClassSlots.Clear();
+	NumLive = 0;
+	Head = 0;
+	Generation++;
+
+	for (auto node : toDelete)
+	{
+		// We must intercept all exceptions so that we can continue deleting the list.
+		try
 		{
-			// We must intercept all exceptions so that we can continue deleting the list.
-			try
-			{
-				node->Destroy();
-			}
-			catch (CVMAbortException &exception)
-			{
-				Printf("VM exception in DestroyThinkers:\n");
-				exception.MaybePrintMessage();
-				Printf(PRINT_NONOTIFY | PRINT_BOLD, "%s", exception.stacktrace.GetChars());
-				// forcibly delete this. Cleanup may be incomplete, though.
-				node->ObjectFlags |= OF_YesReallyDelete;
-				delete node;
-				error = true;
-			}
-			catch (CRecoverableError &exception)
-			{
-				Printf(PRINT_NONOTIFY | PRINT_BOLD, "Error in DestroyThinkers: %s\n", exception.GetMessage());
-				// forcibly delete this. Cleanup may be incomplete, though.
-				node->ObjectFlags |= OF_YesReallyDelete;
-				delete node;
-				error = true;
-			}
+			node->Destroy();
+		}
+		catch (CVMAbortException &exception)
+		{
+			Printf("VM exception in DestroyThinkers:\n");
+			exception.MaybePrintMessage();
+			Printf(PRINT_NONOTIFY | PRINT_BOLD, "%s", exception.stacktrace.GetChars());
+			// forcibly delete this. Cleanup may be incomplete, though.
+			node->ObjectFlags |= OF_YesReallyDelete;
+			delete node;
+			error = true;
+		}
+		catch (CRecoverableError &exception)
+		{
+			Printf(PRINT_NONOTIFY | PRINT_BOLD, "Error in DestroyThinkers: %s\n", exception.GetMessage());
+			// forcibly delete this. Cleanup may be incomplete, though.
+			node->ObjectFlags |= OF_YesReallyDelete;
+			delete node;
+			error = true;
 		}
 	}
 	return error;
@@ -567,38 +686,42 @@ bool FThinkerList::DoDestroyThinkers()
 
 void FThinkerList::SaveList(FSerializer &arc)
 {
-	auto node = GetHead();
-	if (node != nullptr)
+	for (unsigned i = Head; i < Items.Size(); i++)
 	{
-		while (!(node->ObjectFlags & OF_Sentinel))
+		DThinker *node = Items[i];
+		if (node != nullptr)
 		{
-			assert(node->NextThinker != nullptr && !(node->NextThinker->ObjectFlags & OF_EuthanizeMe));
+			assert(!(node->ObjectFlags & OF_EuthanizeMe));
 			::Serialize<DThinker>(arc, nullptr, node, nullptr);
-			node = node->NextThinker;
 		}
 	}
 }
 
 //==========================================================================
 //
-//
+// Thinkers that get added to this list while it is ticking are appended
+// to the array and get ticked in the same pass, just like with the old
+// linked list.
 //
 //==========================================================================
 
 int FThinkerList::TickThinkers(FThinkerList *dest)
 {
 	int count = 0;
-	DThinker *node = GetHead();
 
-	if (node == nullptr)
+	// Do not cache Items' data pointer here. Ticking may add thinkers and reallocate the array.
+	// Only an index is kept between thinkers, so unlike the old NextToThink pointer nothing
+	// needs to be protected from the GC: a thinker destroyed by another one leaves an empty
+	// slot, and anything that still is in the list gets marked through it.
+	for (unsigned i = Head; i < Items.Size(); i++)
 	{
-		return 0;
-	}
+		DThinker *node = Items[i];
+		if (node == nullptr)
+		{
+			continue;
+		}
 
-	while (node != Sentinel)
-	{
 		++count;
-		NextToThink = node->NextThinker;
 		if (node->ObjectFlags & OF_JustSpawned)
 		{
 			// Leave OF_JustSpawn set until after Tick() so the ticker can check it.
@@ -616,11 +739,22 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 
 		if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
-			ThinkCount++;
-			node->CallTick();
+			if (node->Asleep && node->SleepTick())
+			{
+				SleepCount++;
+			}
+			else
+			{
+				ThinkCount++;
+				node->CallTick();
+			}
 			node->ObjectFlags &= ~OF_JustSpawned;
 		}
-		node = NextToThink;
+	}
+	if (dest != nullptr)
+	{
+		// Everything in the fresh list has been moved out.
+		Compact(true);
 	}
 	return count;
 }
@@ -633,17 +767,16 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 int FThinkerList::ProfileThinkers(FThinkerList *dest)
 {
 	int count = 0;
-	DThinker *node = GetHead();
 
-	if (node == nullptr)
+	for (unsigned i = Head; i < Items.Size(); i++)
 	{
-		return 0;
-	}
+		DThinker *node = Items[i];
+		if (node == nullptr)
+		{
+			continue;
+		}
 
-	while (node != Sentinel)
-	{
 		++count;
-		NextToThink = node->NextThinker;
 		if (node->ObjectFlags & OF_JustSpawned)
 		{
 			// Leave OF_JustSpawn set until after Tick() so the ticker can check it.
@@ -661,21 +794,29 @@ int FThinkerList::ProfileThinkers(FThinkerList *dest)
 
 		if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
-			ThinkCount++;
-
 			auto &prof = Profiles[node->GetClass()->TypeName];
 			prof.numcalls++;
 			prof.timer.Clock();
-			node->CallTick();
+			if (node->Asleep && node->SleepTick())
+			{
+				SleepCount++;
+			}
+			else
+			{
+				ThinkCount++;
+				node->CallTick();
+			}
 			prof.timer.Unclock();
 			node->ObjectFlags &= ~OF_JustSpawned;
 		}
-		node = NextToThink;
+	}
+	if (dest != nullptr)
+	{
+		Compact(true);
 	}
 	return count;
 }
 
-
 //==========================================================================
 //
 //
@@ -684,17 +825,12 @@ int FThinkerList::ProfileThinkers(FThinkerList *dest)
 
 DThinker::~DThinker ()
 {
-	assert(NextThinker == nullptr && PrevThinker == nullptr);
+	assert(OwnerList == nullptr);
 }
 
 void DThinker::OnDestroy ()
 {
-	assert((NextThinker != nullptr && PrevThinker != nullptr) ||
-		   (NextThinker == nullptr && PrevThinker == nullptr));
-	if (NextThinker != nullptr)
-	{
-		Remove();
-	}
+	Remove();
 	Super::OnDestroy();
 }
 
@@ -712,23 +848,8 @@ void DThinker::Serialize(FSerializer &arc)
 
 void DThinker::Remove()
 {
-	if (this == NextToThink)
-	{
-		NextToThink = NextThinker;
-	}
-	DThinker *prev = PrevThinker;
-	DThinker *next = NextThinker;
-	if (prev == nullptr && next == nullptr) return;	// This was already removed earlier.
-
-	assert((ObjectFlags & OF_Sentinel) || (prev != this && next != this));
-	assert(prev->NextThinker == this);
-	assert(next->PrevThinker == this);
-	prev->NextThinker = next;
-	next->PrevThinker = prev;
-	GC::WriteBarrier(prev, next);
-	GC::WriteBarrier(next, prev);
-	NextThinker = nullptr;
-	PrevThinker = nullptr;
+	if (OwnerList == nullptr) return;	// This was already removed earlier.
+	OwnerList->Remove(this);
 }
 
 //==========================================================================
@@ -897,6 +1018,12 @@ DEFINE_ACTION_FUNCTION(DThinker, Tick)
 	return 0;
 }
 
+bool DThinker::SleepTick()
+{
+	Asleep = false;
+	return false;
+}
+
 void DThinker::CallTick()
 {
 	IFVIRTUAL(DThinker, Tick)
@@ -916,14 +1043,7 @@ void DThinker::CallTick()
 
 size_t DThinker::PropagateMark()
 {
-	// Do not choke on partially initialized objects (as happens when loading a savegame fails)
-	if (NextThinker != nullptr || PrevThinker != nullptr)
-	{
-		assert(NextThinker != nullptr && !(NextThinker->ObjectFlags & OF_EuthanizeMe));
-		assert(PrevThinker != nullptr && !(PrevThinker->ObjectFlags & OF_EuthanizeMe));
-	}
-	GC::Mark(NextThinker);
-	GC::Mark(PrevThinker);
+	// The thinker lists are marked as roots by FThinkerCollection::MarkRoots.
 	return Super::PropagateMark();
 }
 
@@ -972,14 +1092,15 @@ FThinkerIterator::FThinkerIterator (FLevelLocals *l, const PClass *type, int sta
 		m_SkipOne = (forceSearch && statnum <= STAT_FIRST_THINKING);
 	}
 	m_ParentType = type;
-	if (prev == nullptr || (prev->NextThinker->ObjectFlags & OF_Sentinel))
-	{
-		Reinit();
-	}
-	else
+	Reinit();
+	if (prev != nullptr && prev->OwnerList != nullptr && prev->OwnerList->GetTail() != prev)
 	{
-		m_CurrThinker = prev->NextThinker;
-		m_SearchingFresh = false;
+		m_List = prev->OwnerList;
+		m_FastClass = nullptr;
+		m_FastEnd = 0;
+		m_LastThinker = prev;
+		m_Index = prev->ListIndex + 1;
+		m_Generation = m_List->Generation;
 	}
 }
 
@@ -989,12 +1110,85 @@ FThinkerIterator::FThinkerIterator (FLevelLocals *l, const PClass *type, int sta
 //
 //==========================================================================
 
+enum { LIST_NOT_STARTED = ~0u };
+
 void FThinkerIterator::Reinit ()
 {
-	m_CurrThinker = Level->Thinkers.Thinkers[m_Stat].GetHead();
+	// The list gets set up by the first call to Next, which knows whether an exact match is wanted.
+	m_List = &Level->Thinkers.Thinkers[m_Stat];
+	m_FastClass = nullptr;
+	m_FastEnd = 0;
+	m_LastThinker = nullptr;
+	m_Index = LIST_NOT_STARTED;
+	m_Generation = m_List->Generation;
 	m_SearchingFresh = false;
 }
 
+//==========================================================================
+//
+// If the list is long and only one class in it can match, only that
+// class's slots will be looked at. This only covers the slots that exist
+// now. Thinkers added later may be of another matching class, so the rest
+// of the list is searched normally afterwards.
+//
+//==========================================================================
+
+void FThinkerIterator::StartList(FThinkerList *list, bool exact)
+{
+	m_List = list;
+	m_FastClass = nullptr;
+	m_FastEnd = 0;
+	m_LastThinker = nullptr;
+	m_Index = list->Head;
+	m_Generation = list->Generation;
+
+	if (list->Items.Size() - list->Head >= FAST_ITERATE_MIN)
+	{
+		bool none;
+		const PClass *cls = list->FindOnlyMatchingClass(m_ParentType, exact, none);
+		if (none)
+		{
+			m_Index = list->Items.Size();
+		}
+		else if (cls != nullptr)
+		{
+			m_FastClass = cls;
+			m_FastEnd = list->Items.Size();
+			m_Index = 0;
+		}
+	}
+}
+
+//==========================================================================
+//
+// The list was compacted since the last call, so the slot numbers have
+// changed. Continue after the last thinker that was returned.
+//
+//==========================================================================
+
+bool FThinkerIterator::Resume()
+{
+	m_Generation = m_List->Generation;
+	if (m_LastThinker == nullptr)
+	{
+		// Nothing was returned from this list yet.
+		return false;
+	}
+	if (m_LastThinker->OwnerList != m_List)
+	{
+		// There is no chance to recover, we have to terminate the iteration of this list.
+		m_FastClass = nullptr;
+		m_Index = m_List->Items.Size();
+		return true;
+	}
+
+	// Slots added before the compaction may not have been searched yet and cannot be told
+	// apart from the old ones anymore, so the rest of the list gets searched normally.
+	m_FastClass = nullptr;
+	m_Index = m_LastThinker->ListIndex + 1;
+	return true;
+}
+
 //==========================================================================
 //
 //
@@ -1007,34 +1201,57 @@ DThinker *FThinkerIterator::Next (bool exact)
 	{
 		return nullptr;
 	}
+	if (m_Index == LIST_NOT_STARTED)
+	{
+		StartList(m_List, exact);
+	}
 	do
 	{
 		if(m_SkipOne && m_Stat == STAT_FIRST_THINKING) m_SkipOne = false;
 
 		do
 		{
-			if (m_CurrThinker != nullptr)
+			if (m_Generation != m_List->Generation && !Resume())
 			{
-				while (!(m_CurrThinker->ObjectFlags & OF_Sentinel))
+				StartList(m_List, exact);
+			}
+
+			FThinkerList *list = m_List;
+			if (m_FastClass != nullptr)
+			{
+				auto slots = list->ClassSlots.CheckKey(m_FastClass);
+				unsigned count = slots != nullptr ? slots->Size() : 0;
+				while (m_Index < count && (*slots)[m_Index] < m_FastEnd)
 				{
-					DThinker *thinker = m_CurrThinker;
-					m_CurrThinker = thinker->NextThinker;
-					if (exact)
-					{
-						if (thinker->IsA(m_ParentType)) return thinker;
-					}
-					else if (thinker->IsKindOf(m_ParentType))
+					DThinker *thinker = list->Items[(*slots)[m_Index]];
+					m_Index++;
+					if (thinker != nullptr && (exact ? thinker->IsA(m_ParentType) : thinker->IsKindOf(m_ParentType)))
 					{
+						m_LastThinker = thinker;
 						return thinker;
 					}
-					// This can actually happen when a Destroy call on 'thinker' happens to destroy 'm_CurrThinker'.
-					// In that case there is no chance to recover, we have to terminate the iteration of this list.
-					if (m_CurrThinker == nullptr) break;
+				}
+				// Continue with everything that was added since.
+				m_FastClass = nullptr;
+				m_Index = m_FastEnd;
+			}
+			while (m_Index < list->Items.Size())
+			{
+				DThinker *thinker = list->Items[m_Index];
+				m_Index++;
+				if (thinker == nullptr)
+				{
+					continue;
+				}
+				if (exact ? thinker->IsA(m_ParentType) : thinker->IsKindOf(m_ParentType))
+				{
+					m_LastThinker = thinker;
+					return thinker;
 				}
 			}
 			if ((m_SearchingFresh = !m_SearchingFresh))
 			{
-				m_CurrThinker = Level->Thinkers.FreshThinkers[m_Stat].GetHead();
+				StartList(&Level->Thinkers.FreshThinkers[m_Stat], exact);
 			}
 		} while (m_SearchingFresh);
 		if (m_SearchStats)
@@ -1045,7 +1262,7 @@ DThinker *FThinkerIterator::Next (bool exact)
 				m_Stat = STAT_FIRST_THINKING;
 			}
 		}
-		m_CurrThinker = Level->Thinkers.Thinkers[m_Stat].GetHead();
+		StartList(&Level->Thinkers.Thinkers[m_Stat], exact);
 		m_SearchingFresh = false;
 	} while (m_SearchStats && (m_SkipOne || m_Stat != STAT_FIRST_THINKING));
 	return nullptr;
@@ -1060,6 +1277,6 @@ DThinker *FThinkerIterator::Next (bool exact)
 ADD_STAT (think)
 {
 	FString out;
-	out.Format ("Think time = %04.2f ms - %d thinkers, Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, ActionCycles.TimeMS());
+	out.Format ("Think time = %04.2f ms - %d thinkers, %d asleep, Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, SleepCount, ActionCycles.TimeMS());
 	return out;
 }
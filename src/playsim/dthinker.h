@@ -50,11 +50,18 @@ class FThinkerIterator;
 
 enum { MAX_STATNUM = 127 };
 
-// Doubly linked ring list of thinkers
+// List of thinkers in tick order.
+//
+// The thinkers are kept in a contiguous array. A thinker's slot in it stays the
+// same until the list is compacted, which only happens between tics, so removing
+// a thinker just clears its slot. New thinkers are always appended at the end.
+// Each class also has an ascending list of the slots holding its instances, so
+// iterators looking for a single class do not need to look at anything else.
 struct FThinkerList
 {
 	// No destructor. If this list goes away it's the GC's task to clean the orphaned thinkers. Otherwise this may clash with engine shutdown.
 	void AddTail(DThinker *thinker);
+	void Remove(DThinker *thinker);
 	DThinker *GetHead() const;
 	DThinker *GetTail() const;
 	bool IsEmpty() const;
@@ -63,11 +70,20 @@ struct FThinkerList
 	int TickThinkers(FThinkerList *dest);	// Returns: # of thinkers ticked
 	int ProfileThinkers(FThinkerList *dest);
 	void SaveList(FSerializer &arc);
+	void MarkThinkers();
+	void Compact(bool force = false);
 
 private:
-	DThinker *Sentinel = nullptr;
+	const PClass *FindOnlyMatchingClass(const PClass *type, bool exact, bool &none) const;
+
+	TArray<DThinker *> Items;
+	TMap<const PClass *, TArray<unsigned>> ClassSlots;
+	unsigned NumLive = 0;
+	unsigned Head = 0;			// no live thinker below this slot
+	unsigned Generation = 0;	// incremented whenever the slots get renumbered
 
 	friend struct FThinkerCollection;
+	friend class FThinkerIterator;
 };
 
 struct FThinkerCollection
@@ -80,6 +96,7 @@ struct FThinkerCollection
 
 	void RunThinkers(FLevelLocals *Level);	// The level is needed to tick the lights
 	void DestroyAllThinkers(bool fullgc = true);
+	void CompactThinkers();
 	void SerializeThinkers(FSerializer &arc, bool keepPlayers);
 	void MarkRoots();
 	DThinker *FirstThinker(int statnum);
@@ -101,6 +118,7 @@ public:
 	virtual ~DThinker ();
 	virtual void Tick ();
 	void CallTick();
+	virtual bool SleepTick();	// Called instead of Tick while asleep. Returns false if the thinker must wake up.
 	virtual void PostBeginPlay ();	// Called just before the first tick
 	virtual void CallPostBeginPlay(); // different in actor.
 	virtual void PostSerialize();
@@ -110,6 +128,11 @@ public:
 	
 	void ChangeStatNum (int statnum);
 
+	void WakeUp()
+	{
+		Asleep = false;
+	}
+
 private:
 	void Remove();
 
@@ -119,12 +142,12 @@ private:
 	friend class DObject;
 	friend class FDoomSerializer;
 
-	DThinker *NextThinker = nullptr, *PrevThinker = nullptr;
+	FThinkerList *OwnerList = nullptr;
+	unsigned ListIndex = 0;		// slot in OwnerList. Kept after removal until the thinker gets linked again.
 
 public:
 	FLevelLocals *Level;
-
-	friend struct FLevelLocals;	// Needs access to FreshThinkers until the thinker storage gets refactored.
+	bool Asleep = false;		// SleepTick gets called instead of Tick. Never serialized.
 };
 
 class FThinkerIterator
@@ -133,7 +156,12 @@ protected:
 	const PClass *m_ParentType;
 private:
 	FLevelLocals *Level;
-	DThinker *m_CurrThinker;
+	FThinkerList *m_List;
+	const PClass *m_FastClass;	// if set, only the slots of this class are being looked at
+	unsigned m_FastEnd;			// the list's size when m_FastClass was chosen. Later slots are searched normally.
+	DThinker *m_LastThinker;
+	unsigned m_Index;			// into the list's slots, or the class's slot list if m_FastClass is set
+	unsigned m_Generation;
 	uint8_t m_Stat;
 	bool m_SearchStats;
 	bool m_SearchingFresh;
@@ -144,6 +172,10 @@ public:
 	FThinkerIterator (FLevelLocals *Level, const PClass *type, int statnum, DThinker *prev, bool forceSearch = false);
 	DThinker *Next (bool exact = false);
 	void Reinit ();
+
+private:
+	void StartList(FThinkerList *list, bool exact);
+	bool Resume();
 };
 
 template <class T> class TThinkerIterator : public FThinkerIterator
@@ -524,9 +524,8 @@ void P_GeometryRadiusAttack(AActor* bombspot, AActor* bombsource, int bombdamage
 	FBoundingBox bombbox(bombspot->X(), bombspot->Y(), bombdistance);
 	FBlockLinesIterator it(bombspot->Level, bombbox);
 	line_t* ln;
-	int vc = validcount;
 	TArray<line_t*> lines;
-	while ((ln = it.Next())) // iterator and Trace both use validcount and interfere with each other
+	while ((ln = it.Next()))
 		lines.Push(ln);
 	for (unsigned i = 0; i < lines.Size(); i++)
 	{
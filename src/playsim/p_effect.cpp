@@ -51,6 +51,7 @@
 #include "g_game.h"
 #include "serializer_doom.h"
 #include "p_visualthinker.h"
+#include "ctpl.h"
 
 #include "hwrenderer/scene/hw_drawstructs.h"
 
@@ -109,28 +110,28 @@ static const struct ColorList {
 
 static void FreeParticle(FLevelLocals* Level, particle_t* particle)
 {
-	auto prev = particle->tprev == NO_PARTICLE? nullptr : &Level->Particles[particle->tprev];
-	int pindex = (int)(particle - Level->Particles.Data());
-	auto tnext = particle->tnext;
-	assert(!prev || (prev->tnext == pindex));
-	if (prev)
-		prev->tnext = tnext;
+	uint32_t pindex = uint32_t(particle - Level->Particles.Data());
+	auto &links = Level->ParticleLinks;
+	uint32_t tprev = links[pindex].tprev;
+	uint32_t tnext = links[pindex].tnext;
+	assert(tprev == NO_PARTICLE || links[tprev].tnext == pindex);
+	if (tprev != NO_PARTICLE)
+		links[tprev].tnext = tnext;
 	else
 		Level->ActiveParticles = tnext;
 
 	if (tnext != NO_PARTICLE)
 	{
-		particle_t* next = &Level->Particles[tnext];
-		assert(next->tprev == pindex);
-		next->tprev = particle->tprev;
+		assert(links[tnext].tprev == pindex);
+		links[tnext].tprev = tprev;
 	}
 	if (Level->OldestParticle == pindex)
 	{
 		assert(tnext == NO_PARTICLE);
-		Level->OldestParticle = particle->tprev;
+		Level->OldestParticle = tprev;
 	}
 	memset(particle, 0, sizeof(particle_t));
-	particle->tnext = Level->InactiveParticles;
+	links[pindex].tnext = Level->InactiveParticles;
 	Level->InactiveParticles = pindex;
 }
 
@@ -144,23 +145,23 @@ static particle_t *NewParticle (FLevelLocals *Level, bool replace = false)
 	}
 	
 	// Array isn't full.
+	auto &links = Level->ParticleLinks;
 	uint32_t current = Level->ActiveParticles;
-	auto result = &Level->Particles[Level->InactiveParticles];
-	Level->InactiveParticles = result->tnext;
-	result->tnext = current;
-	result->tprev = NO_PARTICLE;
-	Level->ActiveParticles = uint32_t(result - Level->Particles.Data());
+	uint32_t index = Level->InactiveParticles;
+	Level->InactiveParticles = links[index].tnext;
+	links[index].tnext = current;
+	links[index].tprev = NO_PARTICLE;
+	Level->ActiveParticles = index;
 
 	if (current != NO_PARTICLE) // More than one active particles
 	{
-		particle_t* next = &Level->Particles[current];
-		next->tprev = Level->ActiveParticles;
+		links[current].tprev = index;
 	}
 	else // Just one active particle
 	{
-		Level->OldestParticle = Level->ActiveParticles;
+		Level->OldestParticle = index;
 	}
-	return result;
+	return &Level->Particles[index];
 }
 
 //
@@ -180,26 +181,28 @@ void P_InitParticles (FLevelLocals *Level)
 		num = r_maxparticles;
 
 	// This should be good, but eh...
-	int NumParticles = clamp<int>(num, 100, 65535);
+	int NumParticles = clamp<int>(num, 100, MAX_PARTICLES);
 
 	Level->Particles.Resize(NumParticles);
+	Level->ParticleLinks.Resize(NumParticles);
 	P_ClearParticles (Level);
 }
 
 void P_ClearParticles (FLevelLocals *Level)
 {
-	int i = 0;
 	Level->OldestParticle = NO_PARTICLE;
 	Level->ActiveParticles = NO_PARTICLE;
 	Level->InactiveParticles = 0;
 	for (auto &p : Level->Particles)
 	{
 		p = {};
-		p.tprev = i - 1;
-		p.tnext = ++i;
 	}
-	Level->Particles.Last().tnext = NO_PARTICLE;
-	Level->Particles.Data()->tprev = NO_PARTICLE;
+	uint32_t count = Level->ParticleLinks.Size();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Level->ParticleLinks[i].tprev = i == 0 ? NO_PARTICLE : i - 1;
+		Level->ParticleLinks[i].tnext = i + 1 == count ? NO_PARTICLE : i + 1;
+	}
 }
 
 // Group particles by subsectors. Because particles are always
@@ -228,13 +231,13 @@ void P_FindParticleSubsectors (FLevelLocals *Level)
 		Level->ParticlesInSubsec.Reserve (Level->subsectors.Size() - Level->ParticlesInSubsec.Size());
 	}
 
-	fillshort (&Level->ParticlesInSubsec[0], Level->subsectors.Size(), NO_PARTICLE);
+	std::fill(&Level->ParticlesInSubsec[0], &Level->ParticlesInSubsec[0] + Level->subsectors.Size(), NO_PARTICLE);
 
 	if (!r_particles)
 	{
 		return;
 	}
-	for (uint16_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->Particles[i].tnext)
+	for (uint32_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->ParticleLinks[i].tnext)
 	{
 		 // Try to reuse the subsector from the last portal check, if still valid.
 		if (Level->Particles[i].subsector == nullptr) Level->Particles[i].subsector = Level->PointInRenderSubsector(Level->Particles[i].Pos);
@@ -281,66 +284,166 @@ void P_InitEffects ()
 	blood2 = ParticleColor(RPART(kind)/3, GPART(kind)/3, BPART(kind)/3);
 }
 
-void P_ThinkParticles (FLevelLocals *Level)
+//==========================================================================
+//
+// P_ThinkParticles
+//
+// The particles only ever read the level, so they are moved on several
+// threads in chunks of the active list. Freeing expired particles changes
+// the lists and is done afterwards on this thread, in list order.
+//
+// Each chunk is moved first and relinked in a second pass, so the subsector
+// lookups run back to back. Particles that did not move horizontally keep
+// their subsector and frozen ones are not looked up at all.
+//
+// Crossing a line portal needs the portal traverser, which is not
+// thread-safe, so levels with line portals are done on one thread.
+//
+//==========================================================================
+
+enum
 {
-	int i = Level->ActiveParticles;
-	particle_t *particle = nullptr, *prev = nullptr;
-	while (i != NO_PARTICLE)
+	PARTICLE_CHUNK = 4096,
+};
+
+enum EParticleThink : uint8_t
+{
+	PTHINK_Still,		// not moved, keeps its subsector
+	PTHINK_Moved,		// only moved vertically
+	PTHINK_MovedXY,		// needs a new subsector
+	PTHINK_Expired,
+};
+
+static ctpl::thread_pool ParticlePool(0);
+static TArray<uint32_t> ThinkList;
+static TArray<uint8_t> ThinkState;
+
+static EParticleThink MoveParticle(FLevelLocals *Level, particle_t *particle, bool frozen)
+{
+	if (frozen && !(particle->flags & SPF_NOTIMEFREEZE))
 	{
-		particle = &Level->Particles[i];
-		i = particle->tnext;
-		if (Level->isFrozen() && !(particle->flags &SPF_NOTIMEFREEZE))
+		if(particle->flags & SPF_LOCAL_ANIM)
 		{
-			if(particle->flags & SPF_LOCAL_ANIM)
-			{
-				particle->animData.SwitchTic++;
-			}
+			particle->animData.SwitchTic++;
+		}
+		return PTHINK_Still;
+	}
+
+	particle->alpha -= particle->fadestep;
+	particle->size += particle->sizestep;
+	if (particle->alpha <= 0 || --particle->ttl <= 0 || (particle->size <= 0))
+	{ // The particle has expired
+		return PTHINK_Expired;
+	}
+
+	// Handle crossing a line portal
+	DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
+	bool movedxy = newxy.X != particle->Pos.X || newxy.Y != particle->Pos.Y;
+	particle->Pos.X = newxy.X;
+	particle->Pos.Y = newxy.Y;
+	particle->Pos.Z += particle->Vel.Z;
+	particle->Vel += particle->Acc;
+
+	if(particle->flags & SPF_ROLL)
+	{
+		particle->Roll += particle->RollVel;
+		particle->RollVel += particle->RollAcc;
+	}
+	return movedxy || particle->subsector == nullptr ? PTHINK_MovedXY : PTHINK_Moved;
+}
 
-			prev = particle;
-			continue;
+static void RelinkParticle(FLevelLocals *Level, particle_t *particle, bool movedxy)
+{
+	if (movedxy) particle->subsector = Level->PointInRenderSubsector(particle->Pos);
+	sector_t *s = particle->subsector->sector;
+	// Handle crossing a sector portal.
+	if (!s->PortalBlocksMovement(sector_t::ceiling))
+	{
+		if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
+		{
+			particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
+			particle->subsector = NULL;
 		}
-		
-		particle->alpha -= particle->fadestep;
-		particle->size += particle->sizestep;
-		if (particle->alpha <= 0 || --particle->ttl <= 0 || (particle->size <= 0))
-		{ // The particle has expired, so free it
-			FreeParticle(Level, particle);
-			continue;
+	}
+	else if (!s->PortalBlocksMovement(sector_t::floor))
+	{
+		if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
+		{
+			particle->Pos += s->GetPortalDisplacement(sector_t::floor);
+			particle->subsector = NULL;
 		}
+	}
+}
 
-		// Handle crossing a line portal
-		DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
-		particle->Pos.X = newxy.X;
-		particle->Pos.Y = newxy.Y;
-		particle->Pos.Z += particle->Vel.Z;
-		particle->Vel += particle->Acc;
+static void ThinkParticleRange(FLevelLocals *Level, unsigned start, unsigned end, bool frozen)
+{
+	particle_t *particles = Level->Particles.Data();
+	bool anymoved = false;
+	for (unsigned i = start; i < end; i++)
+	{
+		ThinkState[i] = MoveParticle(Level, &particles[ThinkList[i]], frozen);
+		anymoved |= ThinkState[i] == PTHINK_Moved || ThinkState[i] == PTHINK_MovedXY;
+	}
+	if (!anymoved)
+	{
+		return;
+	}
+	for (unsigned i = start; i < end; i++)
+	{
+		if (ThinkState[i] == PTHINK_Moved || ThinkState[i] == PTHINK_MovedXY)
+		{
+			RelinkParticle(Level, &particles[ThinkList[i]], ThinkState[i] == PTHINK_MovedXY);
+		}
+	}
+}
 
-		if(particle->flags & SPF_ROLL)
+void P_ThinkParticles (FLevelLocals *Level)
+{
+	ThinkList.Clear();
+	for (uint32_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->ParticleLinks[i].tnext)
+	{
+		ThinkList.Push(i);
+	}
+	unsigned count = ThinkList.Size();
+	if (count == 0)
+	{
+		return;
+	}
+	ThinkState.Resize(count);
+
+	bool frozen = Level->isFrozen();
+	unsigned numchunks = (count + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+	if (numchunks > 1 && !Level->PortalBlockmap.containsLines)
+	{
+		if (ParticlePool.size() == 0)
 		{
-			particle->Roll += particle->RollVel;
-			particle->RollVel += particle->RollAcc;
+			ParticlePool.resize(clamp<int>(std::thread::hardware_concurrency() - 1, 1, 7));
 		}
-		
-		particle->subsector = Level->PointInRenderSubsector(particle->Pos);
-		sector_t *s = particle->subsector->sector;
-		// Handle crossing a sector portal.
-		if (!s->PortalBlocksMovement(sector_t::ceiling))
+
+		std::vector<std::future<void>> jobs;
+		for (unsigned chunk = 1; chunk < numchunks; chunk++)
 		{
-			if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
-				particle->subsector = NULL;
-			}
+			unsigned start = chunk * PARTICLE_CHUNK;
+			unsigned end = min(start + PARTICLE_CHUNK, count);
+			jobs.push_back(ParticlePool.push([=](int) { ThinkParticleRange(Level, start, end, frozen); }));
 		}
-		else if (!s->PortalBlocksMovement(sector_t::floor))
+		ThinkParticleRange(Level, 0, PARTICLE_CHUNK, frozen);
+		for (auto &job : jobs)
 		{
-			if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::floor);
-				particle->subsector = NULL;
-			}
+			job.get();
+		}
+	}
+	else
+	{
+		ThinkParticleRange(Level, 0, count, frozen);
+	}
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (ThinkState[i] == PTHINK_Expired)
+		{
+			FreeParticle(Level, &Level->Particles[ThinkList[i]]);
 		}
-		prev = particle;
 	}
 }
 
@@ -95,15 +95,23 @@ struct particle_t
     FTextureID texture; // +4 = 84
     ERenderStyle style; //+4 = 88
     float Roll, RollVel, RollAcc; //+12 = 100
-    uint16_t    tnext, snext, tprev; //+6 = 106
-	uint16_t flags; //+2 = 108
-	// uint32_t padding; //+4 = 112
+    uint32_t    snext; //+4 = 104
+	uint16_t flags; //+2 = 106
+	// uint16_t padding; //+6 = 112
 	FStandaloneAnimation animData; //+16 = 128
 };
 
 static_assert(sizeof(particle_t) == 128, "Only LP64/LLP64 is supported");
 
-const uint16_t NO_PARTICLE = 0xffff;
+// Links of the active and free lists. These are kept apart from the particles
+// so that walking the lists does not have to load every particle.
+struct particlelink_t
+{
+	uint32_t tnext, tprev;
+};
+
+const uint32_t NO_PARTICLE = 0xffffffff;
+const int MAX_PARTICLES = 65535;
 
 void P_InitParticles(FLevelLocals *);
 void P_ClearParticles (FLevelLocals *Level);
@@ -48,6 +48,8 @@
 #include "p_checkposition.h"
 #include "g_levellocals.h"
 #include "vm.h"
+#include "vmintern.h"
+#include "types.h"
 #include "actorinlines.h"
 #include "a_ceiling.h"
 #include "shadowinlines.h"
@@ -83,6 +85,7 @@ static FRandom pr_enemystrafe("EnemyStrafe");
 // so this CVAR allows to switch it off.
 CVAR(Bool, nomonsterinterpolation, false, CVAR_GLOBALCONFIG|CVAR_ARCHIVE)
 CVAR(Int, sv_dropstyle, 0, CVAR_SERVERINFO | CVAR_ARCHIVE);
+CVAR(Bool, sv_parallellook, false, CVAR_SERVERINFO | CVAR_ARCHIVE);
 
 //
 // P_NewChaseDir related LUT.
@@ -112,6 +115,124 @@ double yspeed[8] = {0,SQRTHALF,1,SQRTHALF,0,-SQRTHALF,-1,-SQRTHALF};
 //
 
 
+//----------------------------------------------------------------------------
+//
+// Sound propagation graph
+//
+//----------------------------------------------------------------------------
+
+static bool PlanesMeet(const line_t *check, const secplane_t &floor, const secplane_t &ceiling)
+{
+	return floor.ZatPoint(check->v1->fPos()) >= ceiling.ZatPoint(check->v1->fPos()) &&
+		floor.ZatPoint(check->v2->fPos()) >= ceiling.ZatPoint(check->v2->fPos());
+}
+
+// A line is closed like a door if the planes of the two sectors meet at it
+// or if the sector sound goes into is closed itself.
+static uint8_t CalcLinkClosed(const line_t *check)
+{
+	sector_t *front = check->sidedef[0]->sector;
+	sector_t *back = check->sidedef[1]->sector;
+	bool shut = PlanesMeet(check, front->floorplane, back->ceilingplane) || PlanesMeet(check, back->floorplane, front->ceilingplane);
+
+	uint8_t closed = 0;
+	if (shut || PlanesMeet(check, back->floorplane, back->ceilingplane)) closed |= 1;
+	if (shut || PlanesMeet(check, front->floorplane, front->ceilingplane)) closed |= 2;
+	return closed;
+}
+
+bool FSoundGraph::IsBuilt(FLevelLocals *Level) const
+{
+	return Nodes.Size() > 0 && Nodes.Size() == Level->sectors.Size();
+}
+
+void FSoundGraph::Build(FLevelLocals *Level)
+{
+	Clear();
+	Nodes.Resize(Level->sectors.Size());
+
+	TArray<int> lineLinks(Level->lines.Size(), true);
+	for (auto &link : lineLinks) link = -1;
+	TArray<int> found;
+
+	for (auto &sec : Level->sectors)
+	{
+		Node &node = Nodes[sec.Index()];
+		node.FirstEdge = Edges.Size();
+		node.Portals[sector_t::floor] = sec.Portals[sector_t::floor];
+		node.Portals[sector_t::ceiling] = sec.Portals[sector_t::ceiling];
+		node.Floor = sec.floorplane;
+		node.Ceiling = sec.ceilingplane;
+		node.CheckedStamp = 0;
+		node.VisitStamp = 0;
+
+		// I wish there was a better method to do this than randomly looking through the portal at a few places...
+		for (int plane : { sector_t::ceiling, sector_t::floor })
+		{
+			if (!sec.PortalIsLinked(plane)) continue;
+
+			found.Clear();
+			DVector2 disp = sec.GetPortalDisplacement(plane);
+			for (auto check : sec.Lines)
+			{
+				int other = Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + disp)->Index();
+				if (found.Find(other) == found.Size())
+				{
+					found.Push(other);
+					Edges.Push({ other, -1, -1, uint8_t(plane == sector_t::ceiling ? EDGE_CEILINGPORTAL : EDGE_FLOORPORTAL), 0 });
+				}
+			}
+		}
+
+		for (auto check : sec.Lines)
+		{
+			if (check->getPortal() != nullptr)
+			{
+				// The destination is looked up when sound gets here.
+				Edges.Push({ -1, check->Index(), -1, EDGE_LINEPORTAL, 0 });
+			}
+
+			if (check->sidedef[1] == nullptr) continue;
+
+			sector_t *front = check->sidedef[0]->sector;
+			sector_t *back = check->sidedef[1]->sector;
+			// Intra-sector lines never carry sound anywhere.
+			if (front == back) continue;
+
+			int &link = lineLinks[check->Index()];
+			if (link < 0)
+			{
+				link = LinkClosed.Push(CalcLinkClosed(check));
+			}
+			bool backwards = front != &sec;
+			Edges.Push({ (backwards ? front : back)->Index(), check->Index(), link, EDGE_LINE, backwards });
+		}
+		node.NumEdges = Edges.Size() - node.FirstEdge;
+	}
+}
+
+// Recalculates the links of a sector whose planes have moved since they were last looked at.
+void FSoundGraph::Validate(FLevelLocals *Level, int sectornum)
+{
+	Node &node = Nodes[sectornum];
+	if (node.CheckedStamp == Stamp) return;
+	node.CheckedStamp = Stamp;
+
+	sector_t *sec = &Level->sectors[sectornum];
+	if (node.Floor == sec->floorplane && node.Ceiling == sec->ceilingplane) return;
+	node.Floor = sec->floorplane;
+	node.Ceiling = sec->ceilingplane;
+
+	for (unsigned i = 0; i < node.NumEdges; i++)
+	{
+		Edge &edge = Edges[node.FirstEdge + i];
+		if (edge.Kind == EDGE_LINE)
+		{
+			LinkClosed[edge.Link] = CalcLinkClosed(&Level->lines[edge.Line]);
+		}
+	}
+}
+
 //----------------------------------------------------------------------------
 //
 // PROC P_RecursiveSound
@@ -128,16 +249,18 @@ struct NoiseTarget
 };
 static TArray<NoiseTarget> NoiseList(128);
 
-static void NoiseMarkSector(sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
+static void NoiseMarkSector(FSoundGraph &graph, sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
 {
+	auto &node = graph.Nodes[sec->Index()];
+
 	// wake up all monsters in this sector
-	if (sec->validcount == validcount
+	if (node.VisitStamp == graph.Stamp
 		&& sec->soundtraversed <= soundblocks + 1)
 	{
 		return; 		// already flooded
 	}
 
-	sec->validcount = validcount;
+	node.VisitStamp = graph.Stamp;
 	sec->soundtraversed = soundblocks + 1;
 	sec->SoundTarget = soundtarget;
 
@@ -148,83 +271,82 @@ static void NoiseMarkSector(sector_t *sec, AActor *soundtarget, bool splash, AAc
 			(!maxdist || (actor->Distance2D(emitter) <= maxdist)))
 		{
 			actor->LastHeard = soundtarget;
+			actor->WakeUp();
 		}
 	}
 	NoiseList.Push({ sec, soundblocks });
 }
 
 
-static void P_RecursiveSound(sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
+static void P_RecursiveSound(FSoundGraph &graph, sector_t *sec, AActor *soundtarget, bool splash, AActor *emitter, int soundblocks, double maxdist)
 {
+	auto Level = sec->Level;
+	int secnum = sec->Index();
+	graph.Validate(Level, secnum);
+	auto &node = graph.Nodes[secnum];
+
 	bool checkabove = !sec->PortalBlocksSound(sector_t::ceiling);
 	bool checkbelow = !sec->PortalBlocksSound(sector_t::floor);
 
-	for (auto check : sec->Lines)
+	// If a sector portal was changed after the graph was built, look through it the slow way.
+	for (int plane : { sector_t::ceiling, sector_t::floor })
 	{
-		// check sector portals
-		// I wish there was a better method to do this than randomly looking through the portal at a few places...
-		if (checkabove)
-		{
-			sector_t *upper = sec->Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + sec->GetPortalDisplacement(sector_t::ceiling));
-			NoiseMarkSector(upper, soundtarget, splash, emitter, soundblocks, maxdist);
-		}
-		if (checkbelow)
-		{
-			sector_t *lower = sec->Level->PointInSector(check->v1->fPos() + check->Delta() / 2 + sec->GetPortalDisplacement(sector_t::floor));
-			NoiseMarkSector(lower, soundtarget, splash, emitter, soundblocks, maxdist);
-		}
-
-		// ... and line portals;
-		FLinePortal *port = check->getPortal();
-		if (port && (port->mFlags & PORTF_SOUNDTRAVERSE))
+		bool &check = plane == sector_t::ceiling ? checkabove : checkbelow;
+		if (check && sec->Portals[plane] != node.Portals[plane])
 		{
-			if (port->mDestination)
+			for (auto line : sec->Lines)
 			{
-				NoiseMarkSector(port->mDestination->frontsector, soundtarget, splash, emitter, soundblocks, maxdist);
+				sector_t *other = Level->PointInSector(line->v1->fPos() + line->Delta() / 2 + sec->GetPortalDisplacement(plane));
+				NoiseMarkSector(graph, other, soundtarget, splash, emitter, soundblocks, maxdist);
 			}
+			check = false;
 		}
+	}
 
-
-		if (check->sidedef[1] == NULL ||
-			!(check->flags & ML_TWOSIDED))
+	for (unsigned i = 0; i < node.NumEdges; i++)
+	{
+		auto &edge = graph.Edges[node.FirstEdge + i];
+		switch (edge.Kind)
 		{
-			continue;
-		}
+		case FSoundGraph::EDGE_CEILINGPORTAL:
+			if (checkabove) NoiseMarkSector(graph, &Level->sectors[edge.Other], soundtarget, splash, emitter, soundblocks, maxdist);
+			break;
 
-		// Early out for intra-sector lines
-		if (check->sidedef[0]->sector == check->sidedef[1]->sector) continue;
+		case FSoundGraph::EDGE_FLOORPORTAL:
+			if (checkbelow) NoiseMarkSector(graph, &Level->sectors[edge.Other], soundtarget, splash, emitter, soundblocks, maxdist);
+			break;
 
-		sector_t *other;
-		if (check->sidedef[0]->sector == sec)
-			other = check->sidedef[1]->sector;
-		else
-			other = check->sidedef[0]->sector;
-
-		// check for closed door
-		if ((sec->floorplane.ZatPoint(check->v1->fPos()) >=
-			other->ceilingplane.ZatPoint(check->v1->fPos()) &&
-			sec->floorplane.ZatPoint(check->v2->fPos()) >=
-			other->ceilingplane.ZatPoint(check->v2->fPos()))
-			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
-				sec->ceilingplane.ZatPoint(check->v1->fPos()) &&
-				other->floorplane.ZatPoint(check->v2->fPos()) >=
-				sec->ceilingplane.ZatPoint(check->v2->fPos()))
-			|| (other->floorplane.ZatPoint(check->v1->fPos()) >=
-				other->ceilingplane.ZatPoint(check->v1->fPos()) &&
-				other->floorplane.ZatPoint(check->v2->fPos()) >=
-				other->ceilingplane.ZatPoint(check->v2->fPos())))
+		case FSoundGraph::EDGE_LINEPORTAL:
 		{
-			continue;
+			FLinePortal *port = Level->lines[edge.Line].getPortal();
+			if (port && (port->mFlags & PORTF_SOUNDTRAVERSE) && port->mDestination)
+			{
+				NoiseMarkSector(graph, port->mDestination->frontsector, soundtarget, splash, emitter, soundblocks, maxdist);
+			}
+			break;
 		}
 
-		if (check->flags & ML_SOUNDBLOCK)
+		case FSoundGraph::EDGE_LINE:
 		{
-			if (!soundblocks)
-				NoiseMarkSector(other, soundtarget, splash, emitter, 1, maxdist);
+			line_t *check = &Level->lines[edge.Line];
+			if (!(check->flags & ML_TWOSIDED)) break;
+
+			// check for closed door
+			graph.Validate(Level, edge.Other);
+			if (graph.LinkClosed[edge.Link] & (edge.Backwards ? 2 : 1)) break;
+
+			sector_t *other = &Level->sectors[edge.Other];
+			if (check->flags & ML_SOUNDBLOCK)
+			{
+				if (!soundblocks)
+					NoiseMarkSector(graph, other, soundtarget, splash, emitter, 1, maxdist);
+			}
+			else
+			{
+				NoiseMarkSector(graph, other, soundtarget, splash, emitter, soundblocks, maxdist);
+			}
+			break;
 		}
-		else
-		{
-			NoiseMarkSector(other, soundtarget, splash, emitter, soundblocks, maxdist);
 		}
 	}
 }
@@ -249,12 +371,18 @@ void P_NoiseAlert (AActor *emitter, AActor *target, bool splash, double maxdist)
 	if (target != NULL && target->player && (target->player->cheats & CF_NOTARGET))
 		return;
 
-	validcount++;
+	auto &graph = emitter->Level->SoundGraph;
+	if (!graph.IsBuilt(emitter->Level))
+	{
+		graph.Build(emitter->Level);
+	}
+	graph.Stamp++;
+
 	NoiseList.Clear();
-	NoiseMarkSector(emitter->Sector, target, splash, emitter, 0, maxdist);
+	NoiseMarkSector(graph, emitter->Sector, target, splash, emitter, 0, maxdist);
 	for (unsigned i = 0; i < NoiseList.Size(); i++)
 	{
-		P_RecursiveSound(NoiseList[i].sec, target, splash, emitter, NoiseList[i].soundblocks, maxdist);
+		P_RecursiveSound(graph, NoiseList[i].sec, target, splash, emitter, NoiseList[i].soundblocks, maxdist);
 	}
 }
 
@@ -1938,6 +2066,183 @@ int P_LookForPlayers (AActor *actor, INTBOOL allaround, FLookExParams *params)
 	}
 }
 
+//==========================================================================
+//
+// P_PrepareTargetSearch
+//
+// Target searches only read the world until they have picked a target, and
+// the sight checks are by far the most expensive part of them. This gets
+// called after the players have moved and before the monsters think. It
+// collects the sight checks of all monsters that are going to look for or
+// chase a target in this tic and runs them in parallel. The serial tick
+// then finds the results in the sight cache, in whatever order it needs
+// them. Each result is checked against the actors' positions, the level
+// geometry and the lines the trace crossed when it gets used, so anything
+// that changes in between only makes the affected results miss the cache
+// and the game plays out exactly as without this.
+//
+// No random numbers are taken here. Monsters whose look is decided by one
+// (sound targets, TIDtoHate, looking for other monsters) simply do their
+// own sight checks.
+//
+// Only the monsters that ended their last tick one tic away from the next
+// state get looked at, so this does not need to go through all actors.
+//
+//==========================================================================
+
+static void AddPlayerQueries(TArray<FSightQuery> &queries, AActor *actor, bool allaround)
+{
+	auto Level = actor->Level;
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (!Level->PlayerInGame(i)) continue;
+
+		player_t *player = Level->Players[i];
+		AActor *mo = player->mo;
+		if (mo == nullptr || !(mo->flags & MF_SHOOTABLE) || player->health <= 0 || (player->cheats & CF_NOTARGET))
+		{
+			continue;
+		}
+		if (!allaround && absangle(actor->AngleTo(mo), actor->Angles.Yaw) > DAngle::fromDeg(90.) &&
+			actor->Distance2D(mo) > actor->meleerange + actor->radius)
+		{
+			continue;	// outside of the default field of view
+		}
+		queries.Push({ actor, mo, SF_SEEPASTSHOOTABLELINES });
+	}
+}
+
+enum ELookAction
+{
+	LOOK_None,
+	LOOK_Look,
+	LOOK_LookEx,
+	LOOK_Chase,
+};
+
+//==========================================================================
+//
+// Finds out if a state's action function is A_Look, A_LookEx or A_Chase.
+// Calls with parameters are wrapped in an anonymous function, so for those
+// the called function is looked for in its constants. A wrong guess only
+// costs some wasted traces.
+//
+//==========================================================================
+
+static VMFunction *LookFunc, *LookExFunc, *ChaseFunc;
+static TMap<VMFunction *, ELookAction> LookActions;
+
+static void UpdateLookFunctions()
+{
+	VMFunction *look, *lookex, *chase;
+	PClass::FindFunction(&look, NAME_Actor, NAME_A_Look);
+	PClass::FindFunction(&lookex, NAME_Actor, NAME_A_LookEx);
+	PClass::FindFunction(&chase, NAME_Actor, NAME_A_Chase);
+	if (look != LookFunc || lookex != LookExFunc || chase != ChaseFunc)
+	{
+		// The VM has been restarted.
+		LookFunc = look;
+		LookExFunc = lookex;
+		ChaseFunc = chase;
+		LookActions.Clear();
+	}
+}
+
+static ELookAction GetLookAction(VMFunction *action)
+{
+	auto check = LookActions.CheckKey(action);
+	if (check != nullptr)
+	{
+		return *check;
+	}
+
+	auto classify = [&](VMFunction *func)
+	{
+		if (func == nullptr) return LOOK_None;
+		if (func == LookFunc) return LOOK_Look;
+		if (func == LookExFunc) return LOOK_LookEx;
+		if (func == ChaseFunc) return LOOK_Chase;
+		return LOOK_None;
+	};
+
+	ELookAction result = classify(action);
+	if (result == LOOK_None && action->Name == NAME_None && !(action->VarFlags & VARF_Native))
+	{
+		auto sfunc = static_cast<VMScriptFunction *>(action);
+		for (unsigned i = 0; i < sfunc->NumKonstA && result == LOOK_None; i++)
+		{
+			result = classify((VMFunction *)sfunc->KonstA[i].v);
+		}
+	}
+	LookActions.Insert(action, result);
+	return result;
+}
+
+void P_AddLookCandidate(AActor *actor)
+{
+	if (sv_parallellook)
+	{
+		actor->Level->LookCandidates.Push(MakeObjPtr<AActor*>(actor));
+	}
+}
+
+void P_PrepareTargetSearch(FLevelLocals *Level)
+{
+	static TArray<FSightQuery> queries;
+	static TArray<AActor *> candidates;
+
+	candidates.Clear();
+	for (auto &actor : Level->LookCandidates)
+	{
+		if (actor != nullptr) candidates.Push(actor);
+	}
+	Level->LookCandidates.Clear();
+
+	if (!sv_parallellook || Level->isFrozen())
+	{
+		return;
+	}
+
+	UpdateLookFunctions();
+	queries.Clear();
+	for (AActor *actor : candidates)
+	{
+		// Only monsters whose state is about to run out call their next action in this tic.
+		if (!(actor->flags3 & MF3_ISMONSTER) || actor->health <= 0 || (actor->flags2 & MF2_DORMANT) ||
+			actor->tics != 1 || actor->state == nullptr || actor->TIDtoHate != 0)
+		{
+			continue;
+		}
+		FState *next = actor->state->GetNextState();
+		if (next == nullptr || next->ActionFunc == nullptr)
+		{
+			continue;
+		}
+
+		ELookAction action = GetLookAction(next->ActionFunc);
+		if (action == LOOK_Look || action == LOOK_LookEx)
+		{
+			// A_LookEx may use a different field of view, so none of the players get skipped for it.
+			AddPlayerQueries(queries, actor, action == LOOK_LookEx || (actor->flags4 & MF4_LOOKALLAROUND));
+		}
+		else if (action == LOOK_Chase)
+		{
+			AActor *target = actor->target;
+			if (target == nullptr || target->health <= 0 || !(target->flags & MF_SHOOTABLE))
+			{
+				AddPlayerQueries(queries, actor, true);
+			}
+			else
+			{
+				// melee range and missile range checks
+				queries.Push({ actor, target, 0 });
+				queries.Push({ actor, target, SF_SEEPASTBLOCKEVERYTHING });
+			}
+		}
+	}
+	P_PrecomputeSight(queries);
+}
+
 //
 // ACTION ROUTINES
 //
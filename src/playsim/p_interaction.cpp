@@ -1112,6 +1112,7 @@ static int DamageMobj (AActor *target, AActor *inflictor, AActor *source, int da
 	{ // Shouldn't happen
 		return -1;
 	}
+	target->WakeUp();
 	FName MeansOfDeath = mod;
 
 	// Spectral targets only take damage from spectral projectiles unless forced or telefragging.
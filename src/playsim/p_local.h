@@ -281,6 +281,15 @@ enum ESightFlags
 	SF_IGNOREWATERBOUNDARY=8
 };
 
+struct FSightQuery
+{
+	AActor *t1, *t2;
+	int flags;
+};
+void	P_PrecomputeSight(const TArray<FSightQuery> &queries);
+void	P_PrepareTargetSearch(FLevelLocals *Level);
+void	P_AddLookCandidate(AActor *actor);
+
 void	P_ResetSightCounters (bool full);
 bool	P_TalkFacing (AActor *player);
 void	P_UseLines (player_t* player);
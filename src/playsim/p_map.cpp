@@ -408,7 +408,6 @@ void P_FindFloorCeiling(AActor *actor, int flags)
 
 	tmf.touchmidtex = false;
 	tmf.abovemidtex = false;
-	validcount++;
 
 	FPortalGroupArray grouplist;
 	FMultiBlockLinesIterator mit(grouplist, actor);
@@ -1859,7 +1858,6 @@ bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, boo
 
 	tm.touchmidtex = false;
 	tm.abovemidtex = false;
-	validcount++;
 
 	// Remove all old entries before returning.
 	spechit.Clear();
@@ -1935,17 +1933,6 @@ bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, boo
 
 	// check lines
 
-	// [RH] We need to increment validcount again, because a function above may
-	// have already set some lines to equal the current validcount.
-	//
-	// Specifically, when DehackedPickup spawns a new item in its TryPickup()
-	// function, that new actor will set the lines around it to match validcount
-	// when it links itself into the world. If we just leave validcount alone,
-	// that will give the player the freedom to walk through walls at will near
-	// a pickup they cannot get, because their validcount will prevent them from
-	// being considered for collision with the player.
-	validcount++;
-
 	// Clear out any residual garbage left behind by PIT_CheckThing induced recursions etc.
 	spechit.Clear();
 	portalhit.Clear();
@@ -6357,6 +6344,33 @@ int P_RadiusAttack(AActor *bombspot, AActor *bombsource, int bombdamage, double
 		targets.Push(thing);
 	}
 
+	// Trace the sight checks of everything that would take damage as one batch. The loop
+	// below still checks everything in order and only finds the traces done already. If the
+	// damage it deals moves something, the affected results miss the sight cache and get redone.
+	if (targets.Size() > 1)
+	{
+		static TArray<FSightQuery> queries;
+
+		queries.Clear();
+		for (AActor *thing : targets)
+		{
+			if ((flags & RADF_NODAMAGE) || (!((bombspot->flags5 | thing->flags5) & MF5_OLDRADIUSDMG) &&
+				!(flags & RADF_OLDRADIUSDAMAGE) && !(thing->Level->i_compatflags2 & COMPATF2_EXPLODE2)))
+			{
+				double points = GetRadiusDamage(false, bombspot, thing, bombdamage, bombdistance, fulldamagedistance, bombsource == thing, !!(flags & RADF_CIRCULAR));
+				double check = int(points) * bombdamage;
+				if (!(check > 0 || (check == 0 && bombspot->flags7 & MF7_FORCEZERORADIUSDMG))) continue;
+			}
+			else
+			{
+				DVector2 vec = bombspot->Vec2To(thing);
+				if (max(fabs(vec.X), fabs(vec.Y)) - thing->radius >= bombdistance) continue;
+			}
+			queries.Push({ thing, bombspot, SF_IGNOREVISIBILITY | SF_IGNOREWATERBOUNDARY });
+		}
+		P_PrecomputeSight(queries);
+	}
+
 	for (AActor *thing : targets)
 	{
 		// Barrels always use the original code, since this makes
@@ -7099,6 +7113,8 @@ bool P_ChangeSector(sector_t *sector, int crunch, double amt, int floorOrCeil, b
 	void(*iterator2)(AActor *, FChangePosition *) = NULL;
 	msecnode_t *n;
 
+	sector->Level->GeometryStamp++;
+
 	cpos.nofit = false;
 	cpos.crushchange = crunch;
 	cpos.moveamt = fabs(amt);
@@ -581,15 +581,59 @@ void AActor::SetOrigin(double x, double y, double z, bool moving)
 //
 
 
+//===========================================================================
+//
+// FVisitMarks
+//
+//===========================================================================
+
+static thread_local TArray<FVisitMarks *> FreeVisitMarks;
+
+FVisitMarks *FVisitMarks::Acquire()
+{
+	FVisitMarks *marks;
+	if (FreeVisitMarks.Pop(marks)) return marks;
+	return new FVisitMarks;
+}
+
+void FVisitMarks::Release(FVisitMarks *marks)
+{
+	FreeVisitMarks.Push(marks);
+}
+
+void FVisitMarks::NewQuery(FLevelLocals *Level)
+{
+	if (Stamp == INT_MAX)
+	{
+		for (auto &mark : Lines) mark = 0;
+		for (auto &mark : Polys) mark = 0;
+		Stamp = 0;
+	}
+	Stamp++;
+
+	// Marks left by a previous level are all older than the new stamp, so they can stay.
+	for (unsigned i = Lines.Size(); i < Level->lines.Size(); i++) Lines.Push(0);
+	for (unsigned i = Polys.Size(); i < Level->Polyobjects.Size(); i++) Polys.Push(0);
+}
+
+bool FVisitMarks::MarkPoly(const FPolyObj *poly)
+{
+	int &mark = Polys[unsigned(poly - poly->Level->Polyobjects.Data())];
+	if (mark == Stamp) return false;
+	mark = Stamp;
+	return true;
+}
+
 //===========================================================================
 //
 // FBlockLinesIterator
 //
 //===========================================================================
 
-FBlockLinesIterator::FBlockLinesIterator(FLevelLocals *l, int _minx, int _miny, int _maxx, int _maxy, bool keepvalidcount)
+FBlockLinesIterator::FBlockLinesIterator(FLevelLocals *l, int _minx, int _miny, int _maxx, int _maxy, FVisitMarks *sharedmarks)
+	: Visited(sharedmarks)
 {
-	if (!keepvalidcount) validcount++;
+	if (sharedmarks == nullptr) Visited->NewQuery(l);
 	Level = l;
 	minx = _minx;
 	maxx = _maxx;
@@ -600,7 +644,7 @@ FBlockLinesIterator::FBlockLinesIterator(FLevelLocals *l, int _minx, int _miny,
 
 void FBlockLinesIterator::init(const FBoundingBox &box)
 {
-	validcount++;
+	Visited->NewQuery(Level);
 	maxy = Level->blockmap.GetBlockY(box.Top());
 	miny = Level->blockmap.GetBlockY(box.Bottom());
 	maxx = Level->blockmap.GetBlockX(box.Right());
@@ -656,12 +700,11 @@ line_t *FBlockLinesIterator::Next()
 			{
 				if (polyIndex == 0)
 				{
-					if (polyLink->polyobj->validcount == validcount)
+					if (!Visited->MarkPoly(polyLink->polyobj))
 					{
 						polyLink = polyLink->next;
 						continue;
 					}
-					polyLink->polyobj->validcount = validcount;
 				}
 
 				line_t *ld = polyLink->polyobj->Linedefs[polyIndex];
@@ -672,13 +715,8 @@ line_t *FBlockLinesIterator::Next()
 					polyIndex = 0;
 				}
 
-				if (ld->validcount == validcount)
-				{
-					continue;
-				}
-				else
+				if (Visited->MarkLine(ld))
 				{
-					ld->validcount = validcount;
 					return ld;
 				}
 			}
@@ -692,9 +730,8 @@ line_t *FBlockLinesIterator::Next()
 				line_t *ld = &Level->lines[*list];
 
 				list++;
-				if (ld->validcount != validcount)
+				if (Visited->MarkLine(ld))
 				{
-					ld->validcount = validcount;
 					return ld;
 				}
 			}
@@ -1162,7 +1199,7 @@ void FMultiBlockThingsIterator::Reset()
 //
 //===========================================================================
 
-TArray<intercept_t> FPathTraverse::intercepts(128);
+thread_local TArray<intercept_t> FPathTraverse::intercepts(128);
 
 
 //===========================================================================
@@ -1179,7 +1216,7 @@ TArray<intercept_t> FPathTraverse::intercepts(128);
 
 void FPathTraverse::AddLineIntercepts(int bx, int by)
 {
-	FBlockLinesIterator it(Level, bx, by, bx, by, true);
+	FBlockLinesIterator it(Level, bx, by, bx, by, Visited.Get());
 	line_t *ld;
 
 	while ((ld = it.Next()))
@@ -1459,7 +1496,7 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		flags |= PT_DELTA;
 	}
 
-	validcount++;
+	Visited->NewQuery(Level);
 	intercept_index = intercepts.Size();
 	Startfrac = startfrac;
 
@@ -1971,20 +2008,11 @@ int P_VanillaPointOnLineSide(double x, double y, const line_t* line)
 
 subsector_t *FLevelLocals::PointInSubsector(double x, double y)
 {
-	int side;
-
 	auto node = HeadGamenode();
 	if (node == nullptr) return &subsectors[0];
 
-	fixed_t xx = FloatToFixed(x);
-	fixed_t yy = FloatToFixed(y);
-	do
-	{
-		side = R_PointOnSide(xx, yy, node);
-		node = (node_t *)node->children[side];
-	} while (!((size_t)node & 1));
-
-	return (subsector_t *)((uint8_t *)node - 1);
+	auto &grid = gamenodes.Size() > 0 ? GameSubsectorGrid : RenderSubsectorGrid;
+	return grid.FindSubsector(node, FloatToFixed(x), FloatToFixed(y));
 }
 
 //==========================================================================
@@ -2024,25 +2052,141 @@ sector_t *FLevelLocals::PointInSectorBuggy(double x, double y)
 
 subsector_t *FLevelLocals::PointInRenderSubsector (fixed_t x, fixed_t y)
 {
-	node_t *node;
-	int side;
-	
 	// single subsector is a special case
 	if (nodes.Size() == 0)
 		return &subsectors[0];
 	
-	node = HeadNode();
-	
-	do
+	return RenderSubsectorGrid.FindSubsector(HeadNode(), x, y);
+}
+
+//==========================================================================
+//
+// FSubsectorGrid :: WalkBSP
+//
+// Continues a point lookup from the given node or subsector.
+//
+//==========================================================================
+
+subsector_t *FSubsectorGrid::WalkBSP(void *node, fixed_t x, fixed_t y)
+{
+	while (!((size_t)node & 1))
 	{
-		side = R_PointOnSide (x, y, node);
-		node = (node_t *)node->children[side];
+		node = ((node_t *)node)->children[R_PointOnSide(x, y, (node_t *)node)];
 	}
-	while (!((size_t)node & 1));
-	
 	return (subsector_t *)((uint8_t *)node - 1);
 }
 
+//==========================================================================
+//
+// FSubsectorGrid :: FindSubsector
+//
+//==========================================================================
+
+subsector_t *FSubsectorGrid::FindSubsector(node_t *head, fixed_t x, fixed_t y) const
+{
+	void *node = StartNode(x, y);
+	return WalkBSP(node != nullptr ? node : head, x, y);
+}
+
+//==========================================================================
+//
+// CellOnSide
+//
+// Returns the side of the partition line all points in the rectangle are
+// on according to R_PointOnSide, or -1 if that cannot be guaranteed.
+//
+// R_PointOnSide's result only depends on the sign of a linear function of
+// the point, so checking the corners is enough as long as the subtractions
+// do not overflow.
+//
+//==========================================================================
+
+static int CellOnSide(int64_t x1, int64_t y1, int64_t x2, int64_t y2, const node_t *node)
+{
+	const int64_t ylo = y1 - node->y, yhi = y2 - node->y;
+	const int64_t xlo = node->x - x2, xhi = node->x - x1;
+	if (ylo < -INT32_MAX || yhi > INT32_MAX || xlo < -INT32_MAX || xhi > INT32_MAX ||
+		node->dx == INT32_MIN || node->dy == INT32_MIN)
+	{
+		return -1;
+	}
+
+	int side = -1;
+	for (int64_t dy : { ylo, yhi })
+	{
+		for (int64_t dx : { xlo, xhi })
+		{
+			int s = ((dy * node->dx + dx * node->dy) >> 32) > 0;
+			if (side == -1) side = s;
+			else if (side != s) return -1;
+		}
+	}
+	return side;
+}
+
+//==========================================================================
+//
+// FSubsectorGrid :: Build
+//
+// The cells get roughly as large as the average subsector.
+//
+//==========================================================================
+
+// Takes effect when the next map gets loaded.
+CVAR(Bool, bsp_lookupgrid, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+void FSubsectorGrid::Build(FLevelLocals *Level, node_t *head, unsigned numsubsectors)
+{
+	Clear();
+	if (!bsp_lookupgrid || head == nullptr || Level->vertexes.Size() == 0)
+		return;
+
+	int64_t minx = INT64_MAX, miny = INT64_MAX, maxx = INT64_MIN, maxy = INT64_MIN;
+	for (auto &v : Level->vertexes)
+	{
+		int64_t x = FloatToFixed(v.fX()), y = FloatToFixed(v.fY());
+		minx = min(minx, x);
+		miny = min(miny, y);
+		maxx = max(maxx, x);
+		maxy = max(maxy, y);
+	}
+
+	const uint64_t maxcells = clamp<uint64_t>(numsubsectors, 256, 1 << 20);
+	int shift = FRACBITS + 4;
+	uint64_t w, h;
+	for (;; shift++)
+	{
+		w = ((maxx - minx) >> shift) + 1;
+		h = ((maxy - miny) >> shift) + 1;
+		if (w * h <= maxcells) break;
+	}
+
+	MinX = minx;
+	MinY = miny;
+	CellShift = shift;
+	Width = unsigned(w);
+	Height = unsigned(h);
+	Cells.Resize(Width * Height);
+
+	const int64_t size = int64_t(1) << shift;
+	for (unsigned cy = 0; cy < Height; cy++)
+	{
+		const int64_t y1 = MinY + cy * size;
+		for (unsigned cx = 0; cx < Width; cx++)
+		{
+			const int64_t x1 = MinX + cx * size;
+			void *node = head;
+			while (!((size_t)node & 1))
+			{
+				int side = CellOnSide(x1, y1, x1 + size - 1, y1 + size - 1, (node_t *)node);
+				if (side < 0) break;
+				node = ((node_t *)node)->children[side];
+			}
+			Cells[cy * Width + cx] = node;
+		}
+	}
+}
+
 
 //==========================================================================
 //
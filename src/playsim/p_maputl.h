@@ -10,6 +10,7 @@
 
 extern int validcount;
 struct FBlockNode;
+struct FPolyObj;
 
 struct divline_t
 {
@@ -211,6 +212,61 @@ private:
 	TArray<uint16_t> data;
 };
 
+//==========================================================================
+//
+// Visit marks for spatial queries
+//
+// A query that must not return the same line or polyobject twice marks
+// what it has seen in a mark set of its own. Mark sets come from a pool
+// per thread and every query gets a new stamp, so nothing ever needs to be
+// cleared and queries running on different threads or inside each other
+// do not see each other's marks.
+//
+//==========================================================================
+
+class FVisitMarks
+{
+	int Stamp = 0;
+	TArray<int> Lines;
+	TArray<int> Polys;
+
+public:
+	void NewQuery(FLevelLocals *Level);
+
+	// These return false if the item was already marked in this query.
+	bool MarkLine(const line_t *ld)
+	{
+		int &mark = Lines[ld->Index()];
+		if (mark == Stamp) return false;
+		mark = Stamp;
+		return true;
+	}
+	bool MarkPoly(const FPolyObj *poly);
+
+	static FVisitMarks *Acquire();
+	static void Release(FVisitMarks *marks);
+};
+
+// Holds a mark set for as long as a query runs, or borrows the one of an enclosing query.
+class FVisitScope
+{
+	FVisitMarks *Marks;
+	bool Owned;
+
+public:
+	FVisitScope() : Marks(FVisitMarks::Acquire()), Owned(true) {}
+	FVisitScope(FVisitMarks *shared) : Marks(shared ? shared : FVisitMarks::Acquire()), Owned(shared == nullptr) {}
+	~FVisitScope()
+	{
+		if (Owned) FVisitMarks::Release(Marks);
+	}
+	FVisitScope(const FVisitScope &) = delete;
+	FVisitScope &operator=(const FVisitScope &) = delete;
+
+	FVisitMarks *operator->() const { return Marks; }
+	FVisitMarks *Get() const { return Marks; }
+};
+
 class FBlockLinesIterator
 {
 	friend class FMultiBlockLinesIterator;
@@ -222,13 +278,15 @@ class FBlockLinesIterator
 	polyblock_t *polyLink;
 	int polyIndex;
 	int *list;
+	FVisitScope Visited;
 
 	void StartBlock(int x, int y);
 
 	FBlockLinesIterator(FLevelLocals *l)  { Level = l; }
 	void init(const FBoundingBox &box);
 public:
-	FBlockLinesIterator(FLevelLocals *Level, int minx, int miny, int maxx, int maxy, bool keepvalidcount = false);
+	// If marks are passed in, lines already seen by the owner of the marks are skipped.
+	FBlockLinesIterator(FLevelLocals *Level, int minx, int miny, int maxx, int maxy, FVisitMarks *sharedmarks = nullptr);
 	FBlockLinesIterator(FLevelLocals *Level, const FBoundingBox &box);
 	line_t *Next();
 	void Reset() { StartBlock(minx, miny); }
@@ -367,7 +425,7 @@ public:
 class FPathTraverse
 {
 protected:
-	static TArray<intercept_t> intercepts;
+	static thread_local TArray<intercept_t> intercepts;
 
 	FLevelLocals *Level;
 	divline_t trace;
@@ -375,6 +433,7 @@ protected:
 	unsigned int intercept_index;
 	unsigned int intercept_count;
 	unsigned int count;
+	FVisitScope Visited;
 
 	virtual void AddLineIntercepts(int bx, int by);
 	virtual void AddThingIntercepts(int bx, int by, FBlockThingsIterator &it, bool compatible);
@@ -183,6 +183,7 @@ CVAR (Bool, cl_missiledecals, true, CVAR_ARCHIVE)
 CVAR (Bool, addrocketexplosion, true, CVAR_ARCHIVE)
 CVAR (Int, cl_pufftype, 0, CVAR_ARCHIVE);
 CVAR (Int, cl_bloodtype, 0, CVAR_ARCHIVE);
+CVAR (Bool, sv_actorsleep, false, CVAR_ARCHIVE|CVAR_SERVERINFO)
 
 // CODE --------------------------------------------------------------------
 
@@ -562,6 +563,7 @@ bool AActor::SetState (FState *newstate, bool nofunction)
 		fprintf (debugfile, "for pl %d: SetState while predicting!\n", Level->PlayerNum(player));
 	
 	auto oldstate = state;
+	Asleep = false;
 	do
 	{
 		if (newstate == NULL)
@@ -4180,6 +4182,12 @@ void AActor::Tick ()
 	static const uint8_t HereticScrollDirs[4] = { 6, 9, 1, 4 };
 	static const uint8_t HereticSpeedMuls[5] = { 5, 10, 25, 30, 35 };
 
+	// Keeps the target awake, see CanSleep.
+	if (target != nullptr)
+	{
+		target->TargetedTime = Level->maptime;
+	}
+
 	// Check for Actor unmorphing, but only on the thing that is the morphed Actor.
 	// Players do their own special checking for this.
 	if (alternative != nullptr && player == nullptr)
@@ -4765,6 +4773,10 @@ void AActor::Tick ()
 			if (!SetState(state->GetNextState()))
 				return; 		// freed itself
 		}
+		if (tics == 1 && (flags3 & MF3_ISMONSTER))
+		{
+			P_AddLookCandidate(this);
+		}
 	}
 
 	if(!(flags9 & MF9_DECOUPLEDANIMATIONS) && modelData && !(modelData->flags & MODELDATA_GET_BONE_INFO_RECALC))
@@ -4772,6 +4784,12 @@ void AActor::Tick ()
 		CalcBones(false);
 	}
 
+	if (sv_actorsleep && CanSleep())
+	{
+		Asleep = true;
+		SleepPos = Pos();
+	}
+
 	if (tics == -1 || state->GetCanRaise())
 	{
 		int respawn_monsters = G_SkillProperty(SKILLP_Respawn);
@@ -4801,6 +4819,114 @@ void AActor::Tick ()
 	}
 }
 
+//==========================================================================
+//
+// AActor :: CanSleep
+//
+// Checks if the next tick would do nothing but count down the state's
+// tics. Such an actor can be put to sleep: its ticks are replaced by
+// SleepTick until the state is about to change or anything else about
+// the actor changes. State transitions always get a full tick, so action
+// functions like A_Look still run at exactly the same time.
+//
+// An actor that is the target of another one stays awake. Every actor
+// with a target marks it in Tick, and since the targeting actor may tick
+// before or after this one, a mark from the last tic counts as well.
+//
+//==========================================================================
+
+bool AActor::CanSleep()
+{
+	if (player != nullptr || alternative != nullptr || Inventory != nullptr || target != nullptr ||
+		freezetics > 0 || state == nullptr || modelData != nullptr || effects != 0 || PoisonDurationReceived > 0)
+	{
+		return false;
+	}
+	if (tics != -1 && tics <= 1)
+	{
+		return false;	// the next tick changes the state
+	}
+	if (TargetedTime >= Level->maptime - 1)
+	{
+		return false;
+	}
+	if ((flags & (MF_SKULLFLY | MF_UNMORPHED)) || (flags2 & (MF2_BLASTED | MF2_WINDTHRUST)) ||
+		(flags4 & MF4_VFRICTION) || (flags6 & MF6_TOUCHY) || (flags7 & MF7_HANDLENODELAY) ||
+		(flags8 & MF8_INSCROLLSEC) || (flags9 & MF9_DECOUPLEDANIMATIONS) || isFrozen())
+	{
+		return false;
+	}
+	if (flags5 & MF5_NOINTERACTION)
+	{
+		if (!Vel.isZero() || !(flags & MF_NOBLOCKMAP))
+			return false;
+	}
+	else
+	{
+		if (!Vel.isZero() || Z() != floorz || Level->BotInfo.botnum > 0)
+			return false;
+
+		// Anything that could make a standing actor move, fade or get damaged by its surroundings.
+		if (((flags & MF_STEALTH) && visdir != 0) || floorsector == nullptr ||
+			floorsector->floorplane.isSlope() || Sector->GetHeightSec() != nullptr ||
+			Sector->e->XFloor.ffloors.Size() > 0 || floorsector->e->XFloor.ffloors.Size() > 0)
+		{
+			return false;
+		}
+		// Crash() would still change the state.
+		if (!(flags6 & MF6_DONTCORPSE) && ((flags & MF_CORPSE) || (flags6 & MF6_KILLED)) &&
+			!(flags3 & MF3_CRASHED) && !(flags & MF_ICECORPSE))
+		{
+			return false;
+		}
+	}
+	if (checkForSpecialSector(this, Sector) || ((Sector->Flags & SECF_KILLMONSTERS) && (flags & MF_SHOOTABLE) && !(flags & MF_FLOAT)))
+	{
+		return false;
+	}
+	if (tics == -1 || state->GetCanRaise())
+	{
+		// The nightmare respawn check must not be skipped.
+		if ((flags5 & MF5_ALWAYSRESPAWN) || (G_SkillProperty(SKILLP_Respawn) && (flags3 & MF3_ISMONSTER) &&
+			!(flags2 & MF2_DORMANT) && !(flags5 & MF5_NEVERRESPAWN)))
+		{
+			return false;
+		}
+	}
+	IFOVERRIDENVIRTUALPTRNAME(this, NAME_Actor, Tick)
+	{
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// AActor :: SleepTick
+//
+// Does what Tick would have done for a sleeping actor, unless the actor
+// was changed in a way that may need a full tick.
+//
+//==========================================================================
+
+bool AActor::SleepTick()
+{
+	if (!sv_actorsleep || Pos() != SleepPos || !CanSleep())
+	{
+		Asleep = false;
+		return false;
+	}
+	if (tics != -1)
+	{
+		tics--;
+		if (tics == 1 && (flags3 & MF3_ISMONSTER))
+		{
+			P_AddLookCandidate(this);
+		}
+	}
+	return true;
+}
+
 //==========================================================================
 //
 // AActor :: CheckNoDelay
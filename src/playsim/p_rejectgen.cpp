@@ -0,0 +1,623 @@
+/*
+** p_rejectgen.cpp
+** Generates a sector visibility matrix for maps without a REJECT lump
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The map is turned into a graph of sectors connected by portals. A portal
+** is every GL seg whose two sides belong to different sectors, except for
+** the segs of one-sided lines. Minisegs without a partner lead into the void,
+** which is a node of its own, so that unclosed sectors are handled properly.
+**
+** Visibility is flowed through the portals like a 2D version of Quake's vis:
+** going from a source portal through a chain of portals, every new portal is
+** clipped to the area that lines through the source and the last portal can
+** reach, and the source is clipped the same way from the other side. All
+** clipping errs on the side of visibility. A sector can see another one if
+** the flows from both sides say so.
+**
+** The result is only valid for points that really are inside their sector,
+** so sight checks verify that both actors are inside their subsector's
+** polygon before trusting it. Actors in the void are never rejected.
+**
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <miniz.h>
+#include "g_levellocals.h"
+#include "actor.h"
+#include "files.h"
+#include "m_swap.h"
+#include "p_rejectgen.h"
+#include "doomstat.h"
+
+enum
+{
+	REJECT_CACHE_VERSION = 2,
+	MAX_FLOW_STEPS = 1 << 18,		// per source sector. Beyond that it sees everything.
+	MAX_TOTAL_STEPS = 1 << 26,		// for the whole map. Beyond that the map gets no matrix at all.
+	REJECT_ACTIVATE_TIC = 5 * TICRATE,
+};
+
+static const double REJECT_EPSILON = 1. / 8;
+
+struct FRejectSeg
+{
+	DVector2 v1, v2;
+};
+
+struct FRejectPortal
+{
+	FRejectSeg Seg;
+	unsigned Node[2];
+};
+
+struct FGeneratedReject::FBuilder
+{
+	unsigned NumSectors = 0;		// the void is node NumSectors
+	TArray<FRejectPortal> Portals;
+	TArray<unsigned> FirstPortal;	// into NodePortals, one more entry than there are nodes
+	TArray<unsigned> NodePortals;
+
+	FString CachePath;
+	uint8_t Checksum[16];
+	uint32_t GeometryCRC = 0;
+	bool WriteCache = false;
+
+	TArray<uint8_t> Matrix;			// same layout as a REJECT lump. Only valid when Done is set. Empty if over budget.
+	std::atomic<bool> Done{ false };
+	std::atomic<bool> Cancel{ false };
+	mutable std::atomic<bool> OverBudget{ false };
+	mutable std::atomic<unsigned> TotalSteps{ 0 };
+	std::thread Thread;
+
+	unsigned Other(unsigned portal, unsigned node) const
+	{
+		auto &p = Portals[portal];
+		return p.Node[0] == node ? p.Node[1] : p.Node[0];
+	}
+
+	bool Stopped() const
+	{
+		return Cancel.load(std::memory_order_relaxed) || OverBudget.load(std::memory_order_relaxed);
+	}
+
+	// Each source takes the same number of steps no matter which thread does it,
+	// so whether the map goes over budget is the same on every machine.
+	bool AddSteps(unsigned steps) const
+	{
+		if ((TotalSteps += steps) > MAX_TOTAL_STEPS)
+		{
+			OverBudget = true;
+			return false;
+		}
+		return true;
+	}
+
+	void Run();
+	bool ReadCache();
+	void SaveCache();
+};
+
+//==========================================================================
+//
+// Clipping
+//
+//==========================================================================
+
+// Distance of the point from the line, positive on the left side.
+static inline double LineSide(const DVector2 &org, const DVector2 &dir, double len, const DVector2 &p)
+{
+	return (dir.X * (p.Y - org.Y) - dir.Y * (p.X - org.X)) / len;
+}
+
+// Keeps the part of the segment on the given side of the line.
+static bool ClipSeg(FRejectSeg &seg, const DVector2 &org, const DVector2 &dir, double len, double sign)
+{
+	double f1 = sign * LineSide(org, dir, len, seg.v1) + REJECT_EPSILON;
+	double f2 = sign * LineSide(org, dir, len, seg.v2) + REJECT_EPSILON;
+	if (f1 >= 0 && f2 >= 0) return true;
+	if (f1 < 0 && f2 < 0) return false;
+	DVector2 mid = seg.v1 + (seg.v2 - seg.v1) * (f1 / (f1 - f2));
+	if (f1 < 0) seg.v1 = mid;
+	else seg.v2 = mid;
+	return true;
+}
+
+// Clips the target to the part that a line through the source and the pass
+// can reach. Returns false if nothing is left.
+static bool ClipToSeparators(const FRejectSeg &source, const FRejectSeg &pass, FRejectSeg &target)
+{
+	const DVector2 sv[2] = { source.v1, source.v2 };
+	const DVector2 pv[2] = { pass.v1, pass.v2 };
+
+	// The target must be behind the pass if the source is entirely in front of it.
+	DVector2 pdir = pv[1] - pv[0];
+	double plen = pdir.Length();
+	if (plen > REJECT_EPSILON)
+	{
+		double f1 = LineSide(pv[0], pdir, plen, sv[0]);
+		double f2 = LineSide(pv[0], pdir, plen, sv[1]);
+		if (f1 > REJECT_EPSILON && f2 > REJECT_EPSILON)
+		{
+			if (!ClipSeg(target, pv[0], pdir, plen, -1)) return false;
+		}
+		else if (f1 < -REJECT_EPSILON && f2 < -REJECT_EPSILON)
+		{
+			if (!ClipSeg(target, pv[0], pdir, plen, 1)) return false;
+		}
+	}
+
+	// A separator goes through an end of the source and an end of the pass and has them on opposite sides.
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			DVector2 dir = pv[j] - sv[i];
+			double len = dir.Length();
+			if (len < REJECT_EPSILON) continue;
+
+			double fs = LineSide(sv[i], dir, len, sv[1 - i]);
+			double fp = LineSide(sv[i], dir, len, pv[1 - j]);
+			if (fabs(fs) < REJECT_EPSILON || fabs(fp) < REJECT_EPSILON || (fs > 0) == (fp > 0)) continue;
+
+			if (!ClipSeg(target, sv[i], dir, len, fp > 0 ? 1 : -1)) return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// FRejectFlow
+//
+// Finds everything one sector can see.
+//
+//==========================================================================
+
+class FRejectFlow
+{
+	struct Frame
+	{
+		FRejectSeg Source, Pass;
+		unsigned Node;
+		unsigned PassPortal;
+		unsigned Next;
+	};
+
+	const FGeneratedReject::FBuilder &Builder;
+	TArray<uint8_t> OnChain;		// a line cannot be crossed twice
+	TArray<Frame> Stack;
+	uint8_t *Row;
+
+	void SetVisible(unsigned node)
+	{
+		if (node < Builder.NumSectors) Row[node >> 3] |= 1 << (node & 7);
+	}
+
+public:
+	FRejectFlow(const FGeneratedReject::FBuilder &builder) : Builder(builder)
+	{
+		OnChain.Resize(builder.Portals.Size());
+		memset(OnChain.Data(), 0, OnChain.Size());
+	}
+
+	// Returns false if it got cancelled or the map went over its budget.
+	bool Run(unsigned source, uint8_t *row)
+	{
+		auto &portals = Builder.Portals;
+		auto &nodeportals = Builder.NodePortals;
+		auto &first = Builder.FirstPortal;
+		unsigned steps = 0;
+
+		Row = row;
+		SetVisible(source);
+		for (unsigned i = first[source]; i < first[source + 1]; i++)
+		{
+			unsigned p1 = nodeportals[i];
+			unsigned x = Builder.Other(p1, source);
+			SetVisible(x);
+			OnChain[p1] = 1;
+
+			for (unsigned k = first[x]; k < first[x + 1]; k++)
+			{
+				unsigned p2 = nodeportals[k];
+				if (OnChain[p2]) continue;
+				SetVisible(Builder.Other(p2, x));
+				OnChain[p2] = 1;
+				Stack.Push({ portals[p1].Seg, portals[p2].Seg, Builder.Other(p2, x), p2, first[Builder.Other(p2, x)] });
+
+				while (Stack.Size() > 0)
+				{
+					Frame &frame = Stack.Last();
+					if (frame.Next == first[frame.Node + 1])
+					{
+						OnChain[frame.PassPortal] = 0;
+						Stack.Pop();
+						continue;
+					}
+					unsigned q = nodeportals[frame.Next++];
+					if (OnChain[q]) continue;
+
+					if (++steps > MAX_FLOW_STEPS || ((steps & 1023) == 0 && Builder.Stopped()))
+					{
+						Stack.Clear();
+						memset(OnChain.Data(), 0, OnChain.Size());
+						memset(Row, 0xff, (Builder.NumSectors + 7) / 8);
+						return steps > MAX_FLOW_STEPS && Builder.AddSteps(steps);
+					}
+
+					FRejectSeg target = portals[q].Seg;
+					if (!ClipToSeparators(frame.Source, frame.Pass, target)) continue;
+					FRejectSeg newsource = frame.Source;
+					if (!ClipToSeparators(target, frame.Pass, newsource)) continue;
+
+					unsigned next = Builder.Other(q, frame.Node);
+					SetVisible(next);
+					OnChain[q] = 1;
+					Stack.Push({ newsource, target, next, q, first[next] });	// invalidates frame
+				}
+			}
+			OnChain[p1] = 0;
+		}
+		return Builder.AddSteps(steps);
+	}
+};
+
+//==========================================================================
+//
+// FGeneratedReject :: FBuilder :: Run
+//
+// Runs on its own thread and uses all but one core.
+//
+//==========================================================================
+
+void FGeneratedReject::FBuilder::Run()
+{
+	const unsigned rowbytes = (NumSectors + 7) / 8;
+	TArray<uint8_t> rows(NumSectors * rowbytes, true);
+	memset(rows.Data(), 0, rows.Size());
+
+	std::atomic<unsigned> nextsource{ 0 };
+	auto worker = [&]()
+	{
+		FRejectFlow flow(*this);
+		unsigned source;
+		while ((source = nextsource++) < NumSectors)
+		{
+			if (!flow.Run(source, &rows[source * rowbytes])) return;
+		}
+	};
+
+	int numthreads = max<int>(std::thread::hardware_concurrency(), 2) - 1;
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numthreads; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	if (Cancel) return;
+	if (OverBudget)
+	{
+		// Remember that this map is too complex, so that it doesn't get tried again.
+		if (WriteCache) SaveCache();
+		Done.store(true, std::memory_order_release);
+		return;
+	}
+
+	Matrix.Resize((NumSectors * NumSectors + 7) / 8);
+	memset(Matrix.Data(), 0, Matrix.Size());
+	for (unsigned a = 0; a < NumSectors; a++)
+	{
+		const uint8_t *rowa = &rows[a * rowbytes];
+		for (unsigned b = 0; b < NumSectors; b++)
+		{
+			const uint8_t *rowb = &rows[b * rowbytes];
+			if (!(rowa[b >> 3] & (1 << (b & 7))) || !(rowb[a >> 3] & (1 << (a & 7))))
+			{
+				unsigned pnum = a * NumSectors + b;
+				Matrix[pnum >> 3] |= 1 << (pnum & 7);
+			}
+		}
+	}
+
+	if (WriteCache) SaveCache();
+	Done.store(true, std::memory_order_release);
+}
+
+//==========================================================================
+//
+// Cache
+//
+// Keyed by the map's checksum and the portal geometry, which depends on
+// the nodes. A map that went over budget gets a file without data.
+//
+//==========================================================================
+
+void FGeneratedReject::FBuilder::SaveCache()
+{
+	uLongf outlen = Matrix.Size() > 0 ? compressBound(Matrix.Size()) : 0;
+	TArray<uint8_t> file(32 + outlen, true);
+	if (outlen > 0 && compress(&file[32], &outlen, Matrix.Data(), Matrix.Size()) != Z_OK) return;
+
+	const uint32_t header[3] = { LittleLong(uint32_t(REJECT_CACHE_VERSION)), LittleLong(NumSectors), LittleLong(GeometryCRC) };
+	memcpy(&file[0], "REJC", 4);
+	memcpy(&file[4], header, 12);
+	memcpy(&file[16], Checksum, 16);
+
+	FileWriter *fw = FileWriter::Open(CachePath.GetChars());
+	if (fw != nullptr)
+	{
+		fw->Write(file.Data(), 32 + outlen);
+		delete fw;
+	}
+}
+
+bool FGeneratedReject::FBuilder::ReadCache()
+{
+	FileReader fr;
+	char magic[4];
+	uint8_t checksum[16];
+
+	if (!fr.OpenFile(CachePath.GetChars())) return false;
+	if (fr.Read(magic, 4) != 4 || memcmp(magic, "REJC", 4)) return false;
+	if (fr.ReadUInt32() != REJECT_CACHE_VERSION) return false;
+	if (fr.ReadUInt32() != NumSectors) return false;
+	if (fr.ReadUInt32() != GeometryCRC) return false;
+	if (fr.Read(checksum, 16) != 16 || memcmp(checksum, Checksum, 16)) return false;
+
+	auto compressed = fr.Read(fr.GetLength() - 32);
+	if (compressed.size() == 0)
+	{
+		Done = true;	// over budget
+		return true;
+	}
+	Matrix.Resize((NumSectors * NumSectors + 7) / 8);
+	uLongf outlen = Matrix.Size();
+	if (uncompress(Matrix.Data(), &outlen, compressed.bytes(), (uLong)compressed.size()) != Z_OK || outlen != Matrix.Size())
+	{
+		Matrix.Reset();
+		return false;
+	}
+	Done = true;
+	return true;
+}
+
+//==========================================================================
+//
+// FGeneratedReject :: Start
+//
+//==========================================================================
+
+FGeneratedReject::FGeneratedReject() = default;
+
+FGeneratedReject::~FGeneratedReject()
+{
+	Stop();
+}
+
+void FGeneratedReject::Start(FLevelLocals *Level, const FString &cachepath, const uint8_t *checksum, bool writecache)
+{
+	Stop();
+
+	// Sight goes through linked portals, which this knows nothing about.
+	if (Level->sectors.Size() == 0 || Level->segs.Size() == 0 || Level->Displacements.size > 1)
+		return;
+
+	// One-sided lines only block sight traces if the blockmap knows about them.
+	auto &blockmap = Level->blockmap;
+	TArray<uint8_t> inblockmap(Level->lines.Size(), true);
+	memset(inblockmap.Data(), 0, inblockmap.Size());
+	for (int y = 0; y < blockmap.bmapheight; y++)
+	{
+		for (int x = 0; x < blockmap.bmapwidth; x++)
+		{
+			for (int *list = blockmap.GetLines(x, y); *list != -1; list++)
+			{
+				if ((unsigned)*list < inblockmap.Size()) inblockmap[*list] = 1;
+			}
+		}
+	}
+	for (auto &line : Level->lines)
+	{
+		if (line.backsector == nullptr && !(line.sidedef[0]->Flags & WALLF_POLYOBJ) && !inblockmap[line.Index()])
+			return;
+	}
+
+	auto builder = std::make_unique<FBuilder>();
+	const unsigned numsectors = Level->sectors.Size();
+	const unsigned voidnode = numsectors;
+
+	builder->NumSectors = numsectors;
+	for (auto &seg : Level->segs)
+	{
+		if (seg.linedef != nullptr)
+		{
+			// Polyobjects move away and leave a hole.
+			if (seg.linedef->sidedef[0]->Flags & WALLF_POLYOBJ) return;
+			if (seg.linedef->backsector == nullptr) continue;
+		}
+		if (seg.Subsector == nullptr) return;
+
+		unsigned a = seg.Subsector->sector->Index(), b;
+		auto partner = seg.PartnerSeg;
+		if (partner != nullptr)
+		{
+			if (partner->PartnerSeg == &seg && partner < &seg) continue;	// already added
+			if (partner->Subsector == nullptr) return;
+			b = partner->Subsector->sector->Index();
+		}
+		else
+		{
+			b = seg.linedef != nullptr && seg.backsector != nullptr ? seg.backsector->Index() : voidnode;
+		}
+		if (a == b) continue;
+
+		DVector2 v1 = seg.v1->fPos(), v2 = seg.v2->fPos();
+		DVector2 dir = v2 - v1;
+		double len = dir.Length();
+		if (len > 0)
+		{
+			dir *= 2 * REJECT_EPSILON / len;
+			v1 -= dir;
+			v2 += dir;
+		}
+		builder->Portals.Push({ { v1, v2 }, { a, b } });
+	}
+
+	builder->FirstPortal.Resize(numsectors + 2);
+	memset(builder->FirstPortal.Data(), 0, builder->FirstPortal.Size() * sizeof(unsigned));
+	for (auto &p : builder->Portals)
+	{
+		builder->FirstPortal[p.Node[0] + 1]++;
+		builder->FirstPortal[p.Node[1] + 1]++;
+	}
+	for (unsigned i = 1; i < builder->FirstPortal.Size(); i++)
+	{
+		builder->FirstPortal[i] += builder->FirstPortal[i - 1];
+	}
+	builder->NodePortals.Resize(builder->FirstPortal.Last());
+	TArray<unsigned> fill = builder->FirstPortal;
+	for (unsigned i = 0; i < builder->Portals.Size(); i++)
+	{
+		auto &p = builder->Portals[i];
+		builder->NodePortals[fill[p.Node[0]]++] = i;
+		builder->NodePortals[fill[p.Node[1]]++] = i;
+	}
+
+	builder->CachePath = cachepath;
+	memcpy(builder->Checksum, checksum, 16);
+	builder->GeometryCRC = crc32(0, (const uint8_t *)builder->Portals.Data(), builder->Portals.Size() * sizeof(FRejectPortal));
+	builder->WriteCache = writecache;
+
+	if (!builder->ReadCache())
+	{
+		auto b = builder.get();
+		builder->Thread = std::thread([=]() { b->Run(); });
+	}
+	Builder = std::move(builder);
+}
+
+//==========================================================================
+//
+// FGeneratedReject :: Stop
+//
+//==========================================================================
+
+void FGeneratedReject::Stop()
+{
+	Active = false;
+	if (Builder != nullptr)
+	{
+		Builder->Cancel = true;
+		if (Builder->Thread.joinable())
+		{
+			Builder->Thread.join();
+		}
+		Builder.reset();
+	}
+}
+
+//==========================================================================
+//
+// FGeneratedReject :: CheckActivation
+//
+// The matrix is never used before a fixed tic. In a single player game it
+// is activated on the first tic from then on where the builder is done, so
+// the game thread never waits for it.
+//
+// Net games and demos must start using it on the same tic everywhere, so
+// there the fixed tic is the only chance and this waits for the builder.
+//
+//==========================================================================
+
+void FGeneratedReject::CheckActivation(int maptime)
+{
+	if (Active || Builder == nullptr || maptime < REJECT_ACTIVATE_TIC)
+		return;
+
+	if (!netgame && !demorecording && !demoplayback && !Builder->Done.load(std::memory_order_acquire))
+		return;
+
+	if (Builder->Thread.joinable())
+	{
+		Builder->Thread.join();
+	}
+	if (Builder->Done && Builder->Matrix.Size() > 0)
+	{
+		Active = true;
+	}
+	else
+	{
+		Stop();
+	}
+}
+
+//==========================================================================
+//
+// FGeneratedReject :: Rejects
+//
+// Returns true if t1 cannot possibly see t2.
+//
+//==========================================================================
+
+static bool InsideSubsector(AActor *actor)
+{
+	subsector_t *sub = actor->subsector;
+	if (sub == nullptr || sub->sector != actor->Sector || sub->numlines < 3 || (sub->flags & SSECF_DEGENERATE))
+		return false;
+
+	DVector2 pos = actor->Pos().XY();
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		seg_t *seg = &sub->firstline[i];
+		DVector2 dir = seg->v2->fPos() - seg->v1->fPos();
+		double len = dir.Length();
+		// The subsector is on the right of its segs.
+		if (len == 0 || LineSide(seg->v1->fPos(), dir, len, pos) > -REJECT_EPSILON)
+			return false;
+	}
+	return true;
+}
+
+bool FGeneratedReject::Rejects(AActor *t1, AActor *t2) const
+{
+	if (!Active)
+		return false;
+
+	unsigned pnum = t1->Sector->Index() * Builder->NumSectors + t2->Sector->Index();
+	if (!(Builder->Matrix[pnum >> 3] & (1 << (pnum & 7))))
+		return false;
+
+	return InsideSubsector(t1) && InsideSubsector(t2);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include "tarray.h"
+#include "zstring.h"
+
+struct FLevelLocals;
+class AActor;
+
+// Sector visibility for maps without a usable REJECT lump.
+//
+// The matrix is calculated on background threads after the map has been
+// loaded and is cached on disk next to the cached nodes. Only 2D line of
+// sight is considered: every two-sided line is open and only one-sided lines
+// block, so it should only reject sight that the full trace would also have
+// rejected. The calculation is not exact though, so the game must not depend
+// on when it finishes: it only gets used from a fixed tic on, waiting for it
+// in net games and demos, and maps that take too long to calculate get none
+// at all. Single player games pick it up whenever it is done after that tic.
+//
+// Maps with linked portals or polyobjects in the BSP are left alone.
+struct FGeneratedReject
+{
+	struct FBuilder;
+
+	FGeneratedReject();
+	~FGeneratedReject();
+
+	void Start(FLevelLocals *Level, const FString &cachepath, const uint8_t *checksum, bool writecache);
+	void Stop();
+	void CheckActivation(int maptime);
+	bool Rejects(AActor *t1, AActor *t2) const;
+
+private:
+	std::unique_ptr<FBuilder> Builder;
+	bool Active = false;
+};
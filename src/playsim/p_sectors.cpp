@@ -977,6 +977,7 @@ void CheckPortalPlane(sector_t *sector, int plane)
 		double portalh = sector->GetPortalPlaneZ(plane);
 		double planeh = sector->GetPlaneTexZ(plane);
 		int obstructed = PLANEF_OBSTRUCTED * (plane == sector_t::floor ? planeh > portalh : planeh < portalh);
+		if ((sector->planes[plane].Flags & PLANEF_OBSTRUCTED) != obstructed) sector->Level->GeometryStamp++;
 		sector->planes[plane].Flags = (sector->planes[plane].Flags  & ~PLANEF_OBSTRUCTED) | obstructed;
 	}
 }
@@ -21,6 +21,8 @@
 //-----------------------------------------------------------------------------
 //
 #include <assert.h>
+#include <atomic>
+#include <thread>
 
 #include "doomdef.h"
 
@@ -36,6 +38,7 @@
 
 #include "g_levellocals.h"
 #include "actorinlines.h"
+#include "ctpl.h"
 
 static FRandom pr_botchecksight ("BotCheckSight");
 static FRandom pr_checksight ("CheckSight");
@@ -51,10 +54,153 @@ This uses specialized forms of the maputils routines for optimized performance
 */
 
 // Performance meters
-static int sightcounts[6];
+static thread_local int sightcounts[6];	// only the main thread's get shown
+static thread_local int sightcachecounts[2];	// hits, misses
 static cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
+CVAR(Bool, sv_sightcache, false, CVAR_ARCHIVE|CVAR_SERVERINFO)
+EXTERN_CVAR(Bool, sv_parallellook)
+
+//==========================================================================
+//
+// Sight cache
+//
+// Remembers the results of the sight traces for the current tic. The key
+// contains everything about the actors the trace depends on, so a cached
+// result is dropped as soon as one of them moves. Plane, 3D floor, portal
+// and polyobject changes are caught through FLevelLocals::GeometryStamp.
+//
+// Scripts can change line properties without going through any native
+// code, so each entry also records the lines its trace crossed, along with
+// everything LineBlocksSight looks at. A hit is only used if all of them are
+// still the same.
+//
+// The slot an entry goes into depends on the actors' spawn order, not on
+// their addresses, so the cache evicts the same entries on every machine.
+// Only the trace itself is cached. The random number for invisible targets
+// is always taken.
+//
+//==========================================================================
+
+struct FSightLine
+{
+	line_t *Line;
+	uint32_t Flags;
+	uint32_t Activation;
+	int Special;
+	int Arg1;
+
+	void Set(line_t *ld)
+	{
+		Line = ld;
+		Flags = ld->flags & (ML_TWOSIDED | ML_BLOCKSIGHT | ML_BLOCKEVERYTHING | ML_PORTALCONNECT);
+		Activation = ld->activation & SPAC_Impact;
+		Special = ld->special;
+		Arg1 = ld->args[1];
+	}
+
+	bool Unchanged() const
+	{
+		FSightLine now;
+		now.Set(Line);
+		return now.Flags == Flags && now.Activation == Activation && now.Special == Special && now.Arg1 == Arg1;
+	}
+};
+
+struct FSightCacheEntry
+{
+	AActor *t1, *t2;
+	uint32_t order1, order2;
+	sector_t *sector1;
+	DVector3 pos1, pos2;
+	double height1, height2;
+	int flags;
+	int compatflags;
+	unsigned epoch;		// 0 for unused entries
+	unsigned stamp;
+	unsigned firstline, numlines;	// into SightCacheLines
+	bool result;
+
+	void Set(AActor *a1, AActor *a2, int f, unsigned e)
+	{
+		t1 = a1;
+		t2 = a2;
+		order1 = a1->SpawnOrder;
+		order2 = a2->SpawnOrder;
+		sector1 = a1->Sector;
+		pos1 = a1->Pos();
+		pos2 = a2->Pos();
+		height1 = a1->Height;
+		height2 = a2->Height;
+		flags = f;
+		compatflags = a1->Level->i_compatflags;
+		epoch = e;
+		stamp = a1->Level->GeometryStamp;
+		firstline = numlines = 0;
+		result = false;
+	}
+
+	bool Matches(AActor *a1, AActor *a2, int f, unsigned e) const
+	{
+		return epoch == e && t1 == a1 && t2 == a2 && order1 == a1->SpawnOrder && order2 == a2->SpawnOrder && flags == f &&
+			stamp == a1->Level->GeometryStamp && compatflags == a1->Level->i_compatflags &&
+			sector1 == a1->Sector && pos1 == a1->Pos() && pos2 == a2->Pos() && height1 == a1->Height && height2 == a2->Height;
+	}
+};
+
+enum
+{
+	SIGHT_CACHE_SIZE = 16384,
+	MAX_SIGHT_CACHE_LINES = 1 << 20,	// per tic. Beyond that nothing more gets cached.
+};
+
+static std::atomic<unsigned> SightCacheEpoch{ 1 };	// bumped every tic
+static thread_local TArray<FSightCacheEntry> SightCache;
+static thread_local TArray<FSightLine> SightCacheLines;
+static thread_local unsigned SightCacheLinesEpoch;
+
+static FSightCacheEntry *GetSightCacheEntry(AActor *t1, AActor *t2, int flags, unsigned epoch)
+{
+	if (SightCache.Size() == 0)
+	{
+		SightCache.Resize(SIGHT_CACHE_SIZE);
+		memset(SightCache.Data(), 0, SightCache.Size() * sizeof(FSightCacheEntry));
+	}
+	if (SightCacheLinesEpoch != epoch)
+	{
+		// The entries referring to these are all outdated now.
+		SightCacheLines.Clear();
+		SightCacheLinesEpoch = epoch;
+	}
+	uint64_t hash = t1->SpawnOrder * 0x9E3779B97F4A7C15ull ^ t2->SpawnOrder * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)flags;
+	return &SightCache[(hash >> 32) & (SIGHT_CACHE_SIZE - 1)];
+}
+
+static bool SightCacheLinesUnchanged(const FSightCacheEntry *entry)
+{
+	for (unsigned i = 0; i < entry->numlines; i++)
+	{
+		if (!SightCacheLines[entry->firstline + i].Unchanged()) return false;
+	}
+	return true;
+}
+
+// Fills in an entry for a trace that crossed the given lines. Returns false if it can't be cached.
+static bool StoreSightCacheEntry(FSightCacheEntry *entry, const FSightLine *lines, unsigned numlines, bool result)
+{
+	if (SightCacheLines.Size() + numlines > MAX_SIGHT_CACHE_LINES)
+	{
+		entry->epoch = 0;
+		return false;
+	}
+	entry->firstline = SightCacheLines.Reserve(numlines);
+	entry->numlines = numlines;
+	if (numlines > 0) memcpy(&SightCacheLines[entry->firstline], lines, numlines * sizeof(FSightLine));
+	entry->result = result;
+	return true;
+}
+
 enum
 {
 	SO_TOPFRONT = 1,
@@ -87,12 +233,14 @@ struct SightTask
 };
 
 
-static TArray<intercept_t> intercepts (128);
-static TArray<SightTask> portals(32);
+static thread_local TArray<intercept_t> intercepts (128);
+static thread_local TArray<SightTask> portals(32);
 
 class SightCheck
 {
 	FLevelLocals *Level;
+	FVisitMarks *Visited;
+	TArray<FSightLine> *Crossed;	// if set, gets every line the trace crosses
 	DVector3 sightstart;
 	DVector2 sightend;
 	double Startfrac;
@@ -117,9 +265,11 @@ class SightCheck
 	bool LineBlocksSight(line_t *ld);
 
 public:
-	SightCheck(FLevelLocals *l)
+	SightCheck(FLevelLocals *l, FVisitMarks *visited, TArray<FSightLine> *crossed = nullptr)
 	{
 		Level = l;
+		Visited = visited;
+		Crossed = crossed;
 	}
 
 	bool P_SightPathTraverse ();
@@ -434,11 +584,10 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	if (!Visited->MarkLine(ld))
 	{
 		return true;
 	}
-	ld->validcount = validcount;
 	if (P_PointOnDivlineSide (ld->v1->fPos(), &Trace) ==
 		P_PointOnDivlineSide (ld->v2->fPos(), &Trace))
 	{
@@ -451,6 +600,12 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		return true;		// line isn't crossed
 	}
 
+	if (Crossed != nullptr)
+	{
+		Crossed->Reserve(1);
+		Crossed->Last().Set(ld);
+	}
+
 	if (!portalfound)	// when portals come into play, the quick-outs here may not be performed
 	{
 		if (LineBlocksSight(ld)) return false;
@@ -495,9 +650,8 @@ int SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			if (Visited->MarkPoly(polyLink->polyobj))
 			{
-				polyLink->polyobj->validcount = validcount;
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine(polyLink->polyobj->Linedefs[i]))
@@ -627,7 +781,7 @@ bool SightCheck::P_SightPathTraverse ()
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
+	Visited->NewQuery(Level);
 	intercepts.Clear ();
 	x1 = sightstart.X + Startfrac * Trace.dx;
 	y1 = sightstart.Y + Startfrac * Trace.dy;
@@ -825,6 +979,50 @@ sightcounts[2]++;
 	return traverseres;
 }
 
+//==========================================================================
+//
+// SightTrace
+//
+// The precise part of P_CheckSight: looks from the eyes of t1 to any part
+// of t2. Only reads the level, so it may run on several threads at once as
+// long as nothing gets moved meanwhile. If crossed is given, the lines the
+// trace crossed get added to it.
+//
+//==========================================================================
+
+static bool SightTrace(AActor *t1, AActor *t2, int flags, TArray<FSightLine> *crossed = nullptr)
+{
+	portals.Clear();
+
+	sector_t *sec;
+	double lookheight = t1->Z() + t1->Height*0.75;
+	t1->GetPortalTransition(lookheight, &sec);
+
+	double bottomslope = t2->Z() - lookheight;
+	double topslope = bottomslope + t2->Height;
+	SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
+
+	FVisitScope visited;
+	SightCheck s(t1->Level, visited.Get(), crossed);
+	s.init(t1, t2, sec, &task, flags);
+	bool res = s.P_SightPathTraverse ();
+	if (!res)
+	{
+		double dist = t1->Distance2D(t2);
+		for (unsigned i = 0; i < portals.Size(); i++)
+		{
+			portals[i].Frac += 1 / dist;
+			s.init(t1, t2, NULL, &portals[i], flags);
+			if (s.P_SightPathTraverse())
+			{
+				res = true;
+				break;
+			}
+		}
+	}
+	return res;
+}
+
 /*
 =====================
 =
@@ -843,6 +1041,7 @@ int P_CheckSight (AActor *t1, AActor *t2, int flags)
 	SightCycles.Clock();
 
 	bool res;
+	FSightCacheEntry *cached = nullptr;
 
 	if (t1 == nullptr || t2 == nullptr)
 	{
@@ -904,51 +1103,174 @@ sightcounts[0]++;
 		}
 	}
 
+	// The generated reject is checked this late so that the random number above is
+	// always taken. In net games and demos it starts being used in the same tic everywhere.
+	if (t1->Level->GeneratedReject.Rejects(t1, t2))
+	{
+sightcounts[0]++;
+		res = false;
+		goto done;
+	}
+
+	// sv_parallellook only fills in the results it computed up front. Everything
+	// else only gets remembered if the cache itself is on.
+	if (sv_sightcache || sv_parallellook)
+	{
+		unsigned epoch = SightCacheEpoch.load(std::memory_order_relaxed);
+		cached = GetSightCacheEntry(t1, t2, flags, epoch);
+		if (cached->Matches(t1, t2, flags, epoch) && SightCacheLinesUnchanged(cached))
+		{
+			sightcachecounts[0]++;
+			res = cached->result;
+			goto done;
+		}
+		sightcachecounts[1]++;
+		if (sv_sightcache)
+		{
+			cached->Set(t1, t2, flags, epoch);
+		}
+		else
+		{
+			cached = nullptr;
+		}
+	}
+
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
+	if (cached != nullptr)
+	{
+		static thread_local TArray<FSightLine> crossed;
+		crossed.Clear();
+		res = SightTrace(t1, t2, flags, &crossed);
+		StoreSightCacheEntry(cached, crossed.Data(), crossed.Size(), res);
+	}
+	else
+	{
+		res = SightTrace(t1, t2, flags);
+	}
 
-	validcount++;
-	portals.Clear();
+done:
+	SightCycles.Unclock();
+	return res;
+}
+
+//==========================================================================
+//
+// P_PrecomputeSight
+//
+// Runs the traces for a batch of sight checks that are expected later in
+// the tic on worker threads and puts the results into the calling thread's
+// sight cache. Nothing may move while this runs. The results only get used
+// if the actors, the level geometry and the crossed lines are still the
+// same when P_CheckSight is called for real. Does nothing unless either
+// sv_sightcache or sv_parallellook is on.
+//
+// Pairs that P_CheckSight rejects before tracing are left out. If no more
+// than one chunk is left, nothing is done either: tracing it here on the
+// calling thread would only add the cache handling to the real checks.
+//
+//==========================================================================
+
+static bool SightRejected(const FSightQuery &query)
+{
+	AActor *t1 = query.t1, *t2 = query.t2;
+	if (t1 == nullptr || t2 == nullptr)
+	{
+		return true;
+	}
+	if ((t2->flags8 & MF8_MVISBLOCKED) && !(query.flags & SF_IGNOREVISIBILITY))
 	{
-		sector_t *sec;
-		double lookheight = t1->Z() + t1->Height*0.75;
-		t1->GetPortalTransition(lookheight, &sec);
+		return true;
+	}
+	return !t1->Level->CheckReject(t1->Sector, t2->Sector) || t1->Level->GeneratedReject.Rejects(t1, t2);
+}
+
+//==========================================================================
+//
+//
+//==========================================================================
 
-		double bottomslope = t2->Z() - lookheight;
-		double topslope = bottomslope + t2->Height;
-		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
+enum { SIGHT_CHUNK = 64 };
 
+static ctpl::thread_pool SightPool(0);
 
-		SightCheck s(t1->Level);
-		s.init(t1, t2, sec, &task, flags);
-		res = s.P_SightPathTraverse ();
-		if (!res)
+void P_PrecomputeSight(const TArray<FSightQuery> &queries)
+{
+	struct FResult
+	{
+		unsigned firstline, numlines;	// in the chunk's line list
+		bool result;
+	};
+	static TArray<FResult> results;
+	static TArray<TArray<FSightLine>> chunklines;
+	static TArray<const FSightQuery *> todo;
+
+	if (queries.Size() <= SIGHT_CHUNK || !(sv_sightcache || sv_parallellook))
+	{
+		return;
+	}
+	todo.Clear();
+	for (auto &query : queries)
+	{
+		if (!SightRejected(query)) todo.Push(&query);
+	}
+	unsigned count = todo.Size();
+	unsigned numchunks = (count + SIGHT_CHUNK - 1) / SIGHT_CHUNK;
+	if (numchunks <= 1)
+	{
+		return;
+	}
+	results.Resize(count);
+	if (chunklines.Size() < numchunks) chunklines.Resize(numchunks);
+
+	auto traceRange = [&](unsigned start, unsigned end)
+	{
+		auto &lines = chunklines[start / SIGHT_CHUNK];
+		lines.Clear();
+		for (unsigned i = start; i < end; i++)
 		{
-			double dist = t1->Distance2D(t2);
-			for (unsigned i = 0; i < portals.Size(); i++)
-			{
-				portals[i].Frac += 1 / dist;
-				s.init(t1, t2, NULL, &portals[i], flags);
-				if (s.P_SightPathTraverse())
-				{
-					res = true;
-					break;
-				}
-			}
+			results[i].firstline = lines.Size();
+			results[i].result = SightTrace(todo[i]->t1, todo[i]->t2, todo[i]->flags, &lines);
+			results[i].numlines = lines.Size() - results[i].firstline;
 		}
+	};
+
+	if (SightPool.size() == 0)
+	{
+		SightPool.resize(clamp<int>(std::thread::hardware_concurrency() - 1, 1, 7));
 	}
 
-done:
-	SightCycles.Unclock();
-	return res;
+	std::vector<std::future<void>> jobs;
+	for (unsigned chunk = 1; chunk < numchunks; chunk++)
+	{
+		unsigned start = chunk * SIGHT_CHUNK;
+		unsigned end = min<unsigned>(start + SIGHT_CHUNK, count);
+		jobs.push_back(SightPool.push([=, &traceRange](int) { traceRange(start, end); }));
+	}
+	traceRange(0, SIGHT_CHUNK);
+	for (auto &job : jobs)
+	{
+		job.get();
+	}
+
+	unsigned epoch = SightCacheEpoch.load(std::memory_order_relaxed);
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto &query = *todo[i];
+		auto entry = GetSightCacheEntry(query.t1, query.t2, query.flags, epoch);
+		entry->Set(query.t1, query.t2, query.flags, epoch);
+		auto &lines = chunklines[i / SIGHT_CHUNK];
+		StoreSightCacheEntry(entry, lines.Data() + results[i].firstline, results[i].numlines, results[i].result);
+	}
 }
 
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d, cache %d/%d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		sightcachecounts[0], sightcachecounts[1]);
 	return out;
 }
 
@@ -964,4 +1286,6 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	memset (sightcachecounts, 0, sizeof(sightcachecounts));
+	SightCacheEpoch++;
 }
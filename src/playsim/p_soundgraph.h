@@ -0,0 +1,63 @@
+#pragma once
+
+#include "tarray.h"
+#include "r_defs.h"
+
+struct FLevelLocals;
+
+// Sector adjacency for sound propagation.
+//
+// Built on the first noise alert of a level. Every sector gets a range of
+// edges to the sectors sound can reach from it: across two-sided lines,
+// through sound traversing line portals and through linked sector portals.
+// The sector portal neighbours are found once by sampling the line midpoints,
+// instead of on every alert.
+//
+// Whether a two-sided line is closed like a door depends on the planes of
+// both sectors. This is cached per line and only recalculated for sectors
+// whose planes have changed since the last alert that reached them.
+struct FSoundGraph
+{
+	enum
+	{
+		EDGE_LINE,				// two-sided line, Link is set
+		EDGE_LINEPORTAL,
+		EDGE_CEILINGPORTAL,
+		EDGE_FLOORPORTAL,
+	};
+
+	struct Edge
+	{
+		int Other;				// sector index
+		int Line;				// line index, -1 for sector portals
+		int Link;				// index into LinkClosed for EDGE_LINE
+		uint8_t Kind;
+		uint8_t Backwards;		// going from the line's back sector to its front
+	};
+
+	struct Node
+	{
+		unsigned FirstEdge;
+		unsigned NumEdges;
+		unsigned Portals[2];	// sector portals the portal edges were found for
+		secplane_t Floor, Ceiling;	// plane state the link states were calculated for
+		int CheckedStamp;
+		int VisitStamp;
+	};
+
+	TArray<Node> Nodes;
+	TArray<Edge> Edges;
+	TArray<uint8_t> LinkClosed;	// bit 0: closed going front to back, bit 1: closed going back to front
+	int Stamp = 0;
+
+	bool IsBuilt(FLevelLocals *Level) const;
+	void Build(FLevelLocals *Level);
+	void Validate(FLevelLocals *Level, int sectornum);
+	void Clear()
+	{
+		Nodes.Clear();
+		Edges.Clear();
+		LinkClosed.Clear();
+		Stamp = 0;
+	}
+};
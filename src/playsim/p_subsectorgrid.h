@@ -0,0 +1,44 @@
+#pragma once
+
+#include "tarray.h"
+#include "m_fixed.h"
+
+struct node_t;
+struct subsector_t;
+struct FLevelLocals;
+
+// Shortcut into a BSP tree for point lookups.
+//
+// The map's bounding box is covered by square cells. Every cell stores the
+// deepest node whose ancestors' partition lines all leave the cell on one
+// side, or the subsector itself if there is no partition line crossing the
+// cell at all. A lookup continues the normal BSP walk from there, so it
+// always arrives at the same subsector as a walk from the root.
+//
+// The cells are classified with the same fixed point math as R_PointOnSide.
+// A partition line is only skipped if all four corners of the cell are on
+// the same side and none of the differences can overflow.
+struct FSubsectorGrid
+{
+	TArray<void *> Cells;		// node_t *, or subsector_t * + 1 like node_t::children
+	int64_t MinX = 0, MinY = 0;
+	int CellShift = 0;			// cell size in fixed point units as a power of 2
+	unsigned Width = 0, Height = 0;
+
+	void Build(FLevelLocals *Level, node_t *head, unsigned numsubsectors);
+	subsector_t *FindSubsector(node_t *head, fixed_t x, fixed_t y) const;
+	static subsector_t *WalkBSP(void *node, fixed_t x, fixed_t y);
+	void Clear()
+	{
+		Cells.Reset();
+		Width = Height = 0;
+	}
+
+	void *StartNode(fixed_t x, fixed_t y) const
+	{
+		uint64_t cx = uint64_t(x - MinX) >> CellShift;
+		uint64_t cy = uint64_t(y - MinY) >> CellShift;
+		if (cx >= Width || cy >= Height) return nullptr;
+		return Cells[unsigned(cy) * Width + unsigned(cx)];
+	}
+};
@@ -151,7 +151,7 @@ void FLinePortalTraverse::AddLineIntercepts(int bx, int by)
 		double frac;
 		divline_t dl;
 
-		if (ld->validcount == validcount) continue;	// already processed
+		if (!Visited->MarkLine(ld)) continue;	// already processed
 
 		if (P_PointOnDivlineSide (ld->v1->fPos(), &trace) ==
 			P_PointOnDivlineSide (ld->v2->fPos(), &trace))
@@ -330,6 +330,7 @@ void FLevelLocals::FinalizePortals()
 	CollectLinkedPortals();
 	BuildPortalBlockmap();
 	CreateLinkedPortals();
+	BuildLinkedPortalBlocks();
 }
 
 //============================================================================
@@ -1050,6 +1051,111 @@ void FLevelLocals::CreateLinkedPortals()
 }
 
 
+//============================================================================
+//
+// Precalculates for every block which linked line portals a box in it may
+// touch, so that CollectConnectedGroups does not have to look at all of them
+// for every check. CollectConnectedGroups offsets the box by the displacement
+// from its start group to the portal's group, so the portal's bounding box
+// gets entered at its position as seen from every group connected to it.
+//
+//============================================================================
+
+void FLevelLocals::BuildLinkedPortalBlocks()
+{
+	auto &pb = PortalBlockmap;
+	int numblocks = pb.dx * pb.dy;
+
+	pb.linkedStart.Clear();
+	pb.linkedList.Clear();
+	pb.movingLinked.Clear();
+	if (linkedPortals.Size() == 0 || numblocks == 0) return;
+
+	TArray<TArray<unsigned>> blocks(numblocks, true);
+	for (unsigned i = 0; i < linkedPortals.Size(); i++)
+	{
+		line_t *ld = linkedPortals[i]->mOrigin;
+		if (ld->sidedef[0]->Flags & WALLF_POLYOBJ)
+		{
+			pb.movingLinked.Push(i);
+			continue;
+		}
+		int othergroup = ld->frontsector->PortalGroup;
+		for (int group = 0; group < Displacements.size; group++)
+		{
+			FDisplacement &disp = Displacements(group, othergroup);
+			if (!disp.isSet) continue;
+
+			// Add a block of margin so that rounding errors cannot matter.
+			int x1 = (int)floor((ld->bbox[BOXLEFT] - disp.pos.X - blockmap.bmaporgx) / FBlockmap::MAPBLOCKUNITS) - 1;
+			int x2 = (int)floor((ld->bbox[BOXRIGHT] - disp.pos.X - blockmap.bmaporgx) / FBlockmap::MAPBLOCKUNITS) + 1;
+			int y1 = (int)floor((ld->bbox[BOXBOTTOM] - disp.pos.Y - blockmap.bmaporgy) / FBlockmap::MAPBLOCKUNITS) - 1;
+			int y2 = (int)floor((ld->bbox[BOXTOP] - disp.pos.Y - blockmap.bmaporgy) / FBlockmap::MAPBLOCKUNITS) + 1;
+			x1 = max(x1, 0); y1 = max(y1, 0);
+			x2 = min(x2, pb.dx - 1); y2 = min(y2, pb.dy - 1);
+			for (int y = y1; y <= y2; y++)
+			{
+				for (int x = x1; x <= x2; x++)
+				{
+					auto &list = blocks[x + y * pb.dx];
+					if (list.Size() == 0 || list.Last() != i) list.Push(i);
+				}
+			}
+		}
+	}
+
+	pb.linkedStart.Resize(numblocks + 1);
+	for (int i = 0; i < numblocks; i++)
+	{
+		pb.linkedStart[i] = pb.linkedList.Size();
+		pb.linkedList.Append(blocks[i]);
+	}
+	pb.linkedStart[numblocks] = pb.linkedList.Size();
+}
+
+//============================================================================
+//
+// Collects the linked line portals a box may touch into portalCandidates.
+// Returns false if all of them need to be checked because the box is too
+// large or not entirely inside the blockmap.
+//
+//============================================================================
+
+bool FLevelLocals::CollectPortalCandidates(const DVector2 &position, double checkradius)
+{
+	auto &pb = PortalBlockmap;
+	if (pb.linkedStart.Size() == 0) return false;
+
+	double left = (position.X - checkradius - blockmap.bmaporgx) / FBlockmap::MAPBLOCKUNITS;
+	double right = (position.X + checkradius - blockmap.bmaporgx) / FBlockmap::MAPBLOCKUNITS;
+	double bottom = (position.Y - checkradius - blockmap.bmaporgy) / FBlockmap::MAPBLOCKUNITS;
+	double top = (position.Y + checkradius - blockmap.bmaporgy) / FBlockmap::MAPBLOCKUNITS;
+	if (!(left >= 0 && bottom >= 0 && right < pb.dx && top < pb.dy)) return false;
+
+	int x1 = (int)left, x2 = (int)right;
+	int y1 = (int)bottom, y2 = (int)top;
+	if ((x2 - x1 + 1) * (y2 - y1 + 1) > 16) return false;
+
+	portalCandidates.Clear();
+	portalCandidates.Append(pb.movingLinked);
+	for (int y = y1; y <= y2; y++)
+	{
+		for (int x = x1; x <= x2; x++)
+		{
+			int block = x + y * pb.dx;
+			for (unsigned i = pb.linkedStart[block]; i < pb.linkedStart[block + 1]; i++)
+			{
+				portalCandidates.Push(pb.linkedList[i]);
+			}
+		}
+	}
+	// The portals must be looked at in the same order as without the table.
+	std::sort(portalCandidates.begin(), portalCandidates.end());
+	auto end = std::unique(portalCandidates.begin(), portalCandidates.end());
+	portalCandidates.Clamp(unsigned(end - portalCandidates.begin()));
+	return true;
+}
+
 //============================================================================
 //
 // Collect all portal groups this actor would occupy at the given position
@@ -1078,17 +1184,26 @@ bool FLevelLocals::CollectConnectedGroups(int startgroup, const DVector3 &positi
 		processMask.setBit(thisgroup);
 		//out.Add(thisgroup);
 
-		for (unsigned i = 0; i < linkedPortals.Size(); i++)
+		auto checkPortal = [&](unsigned i)
 		{
 			line_t *ld = linkedPortals[i]->mOrigin;
 			int othergroup = ld->frontsector->PortalGroup;
 			FDisplacement &disp = Displacements(thisgroup, othergroup);
-			if (!disp.isSet) continue;	// no connection.
+			if (!disp.isSet) return;	// no connection.
 
 			FBoundingBox box(position.X + disp.pos.X, position.Y + disp.pos.Y, checkradius);
 
-			if (!inRange(box, ld) || BoxOnLineSide(box, linkedPortals[i]->mOrigin) != -1) continue;	// not touched
+			if (!inRange(box, ld) || BoxOnLineSide(box, linkedPortals[i]->mOrigin) != -1) return;	// not touched
 			foundPortals.Push(linkedPortals[i]);
+		};
+
+		if (CollectPortalCandidates(position.XY(), checkradius))
+		{
+			for (unsigned i : portalCandidates) checkPortal(i);
+		}
+		else
+		{
+			for (unsigned i = 0; i < linkedPortals.Size(); i++) checkPortal(i);
 		}
 		bool foundone = true;
 		while (foundone)
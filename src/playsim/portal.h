@@ -108,6 +108,12 @@ struct FPortalBlockmap
 	bool hasLinkedSectorPortals;	// global flag to shortcut portal checks if the map has none.
 	bool hasLinkedPolyPortals;	// this means that any early-outs in P_CheckSight need to be disabled if a block contains polyobjects.
 
+	// The linked line portals a box overlapping a block may touch, coming from any portal group.
+	// These are indices into FLevelLocals::linkedPortals in ascending order.
+	TArray<unsigned> linkedStart;	// per block into linkedList, plus one for the end
+	TArray<unsigned> linkedList;
+	TArray<unsigned> movingLinked;	// portals on polyobjects can go anywhere so they are always checked
+
 	void Create(int blockx, int blocky)
 	{
 		data.Resize(blockx*blocky);
@@ -123,6 +129,9 @@ struct FPortalBlockmap
 		containsLines = false;
 		hasLinkedPolyPortals = false;
 		hasLinkedSectorPortals = false;
+		linkedStart.Clear();
+		linkedList.Clear();
+		movingLinked.Clear();
 	}
 
 	FPortalBlock &operator()(int x, int y)
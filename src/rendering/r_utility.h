@@ -78,7 +78,7 @@ extern FViewWindow r_viewwindow;
 
 extern int				setblocks;
 extern bool				r_NoInterpolate;
-extern int				validcount;
+extern int				validcount;				// Game thread only. Blockmap, sight and trace queries use FVisitMarks instead.
 extern int				dl_validcount;			// For use with FSection. validcount is in use by the renderer and any quick section exclusion needs another variable.
 
 extern angle_t			LocalViewAngle;			// [RH] Added to consoleplayer's angle
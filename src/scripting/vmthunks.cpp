@@ -740,6 +740,7 @@ DEFINE_ACTION_FUNCTION_NATIVE(_Sector, SetXOffset, SetXOffset)
  static void ChangeFlags(sector_t *self, int pos, int a, int o)
  {
 	 self->ChangeFlags(pos, a, o);
+	 self->Level->GeometryStamp++;	// may open or close a portal for sight checks
  }
 
  DEFINE_ACTION_FUNCTION_NATIVE(_Sector, ChangeFlags, ChangeFlags)
@@ -748,7 +749,7 @@ DEFINE_ACTION_FUNCTION_NATIVE(_Sector, SetXOffset, SetXOffset)
 	 PARAM_INT(pos);
 	 PARAM_INT(a);
 	 PARAM_INT(o);
-	 self->ChangeFlags(pos, a, o);
+	 ChangeFlags(self, pos, a, o);
 	 return 0;
  }
 
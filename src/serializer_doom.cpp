@@ -69,7 +69,7 @@ void FDoomSerializer::CloseReaderCustom()
 		auto think = dyn_cast<DThinker>(obj);
 		if (think != nullptr)
 		{
-			if (think->NextThinker == nullptr || think->PrevThinker == nullptr)
+			if (think->OwnerList == nullptr)
 			{
 				think->Destroy();
 			}
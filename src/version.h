@@ -94,7 +94,7 @@ const char *GetVersionString();
 
 // Use 4500 as the base git save version, since it's higher than the
 // SVN revision ever got.
-#define SAVEVER 4560
+#define SAVEVER 4562
 
 // This is so that derivates can use the same savegame versions without worrying about engine compatibility
 #define GAMESIG "MAIM"